@@ -0,0 +1,191 @@
+/* Compares the size-class allocator with the system malloc over mixed
+ * request sizes, on one thread and with frees on a different thread from
+ * the allocations. Build from the repository root:
+ *
+ *     gcc -O2 -std=gnu11 -iquote include bench/sizeclass_bench.c \
+ *         src/memory.c src/threading.c -lpthread -o sizeclass_bench
+ *     ./sizeclass_bench [ops]
+ *
+ * Results are ns per operation; numbers only mean something relative to
+ * each other on the same machine. */
+#include "containers.h"
+#include "memory.h"
+#include "platform.h"
+#include "threading.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(DISTRO_WIN32)
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#define WORKING_SET 4096
+#define RING_CAPACITY 1024
+
+typedef struct {
+    const char* name;
+    void* (*alloc)(void* ctx, size_t size);
+    void (*free)(void* ctx, void* ptr);
+    void* (*realloc)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+} bench_allocator;
+
+static void* libc_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void libc_free(void* ctx, void* ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+static void* libc_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static const bench_allocator allocators[] = {
+    { "malloc", libc_alloc, libc_free, libc_realloc },
+    { "sizeclass", sizeclass_alloc, sizeclass_free, sizeclass_realloc },
+};
+
+static double now_ns(void) {
+#if defined(DISTRO_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/* Mostly small objects, a tail up to the size-class limit, and a few
+ * requests above it that both allocators hand to malloc */
+static size_t next_size(uint64_t* state) {
+    uint64_t r = next_random(state);
+    unsigned bucket = (unsigned)(r % 100);
+    r >>= 8;
+    if (bucket < 70) return 16 + (size_t)(r % 113);
+    if (bucket < 95) return 129 + (size_t)(r % 896);
+    if (bucket < 99) return 1025 + (size_t)(r % 3072);
+    return SIZECLASS_MAX_SIZE + 1 + (size_t)(r % 12288);
+}
+
+/* Replace random members of a live working set: one free and one alloc */
+static double bench_churn(const bench_allocator* a, size_t ops) {
+    static void* slots[WORKING_SET];
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < WORKING_SET; i++) slots[i] = a->alloc(NULL, next_size(&rng));
+
+    double start = now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        size_t slot = (size_t)(next_random(&rng) % WORKING_SET);
+        a->free(NULL, slots[slot]);
+        slots[slot] = a->alloc(NULL, next_size(&rng));
+        *(char*)slots[slot] = (char)i;
+    }
+    double elapsed = now_ns() - start;
+
+    for (size_t i = 0; i < WORKING_SET; i++) a->free(NULL, slots[i]);
+    return elapsed / (double)ops;
+}
+
+/* Resize random members of a live working set to a new random size */
+static double bench_realloc(const bench_allocator* a, size_t ops) {
+    static void* slots[WORKING_SET];
+    static size_t sizes[WORKING_SET];
+    uint64_t rng = 0x2545f4914f6cdd1dULL;
+    for (size_t i = 0; i < WORKING_SET; i++) {
+        sizes[i] = next_size(&rng);
+        slots[i] = a->alloc(NULL, sizes[i]);
+    }
+
+    double start = now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        size_t slot = (size_t)(next_random(&rng) % WORKING_SET);
+        size_t size = next_size(&rng);
+        slots[slot] = a->realloc(NULL, slots[slot], sizes[slot], size);
+        sizes[slot] = size;
+        *(char*)slots[slot] = (char)i;
+    }
+    double elapsed = now_ns() - start;
+
+    for (size_t i = 0; i < WORKING_SET; i++) a->free(NULL, slots[i]);
+    return elapsed / (double)ops;
+}
+
+/* Through a typedef, the ring's const T* is void* const*, not const void** */
+typedef void* bench_ptr;
+SPSC_RING_DEFINE(bench_ptr, ptr_ring)
+
+typedef struct {
+    const bench_allocator* allocator;
+    ptr_ring* ring;
+    size_t ops;
+} cross_thread_ctx;
+
+static void cross_thread_consumer(void* arg) {
+    cross_thread_ctx* ctx = (cross_thread_ctx*)arg;
+    void* batch[64];
+    size_t freed = 0;
+    while (freed < ctx->ops) {
+        size_t n = ptr_ring_pop_n(ctx->ring, batch, 64);
+        if (!n) {
+            thread_yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) ctx->allocator->free(NULL, batch[i]);
+        freed += n;
+    }
+}
+
+/* One thread allocates, another frees, handing pointers over a ring */
+static double bench_cross_thread(const bench_allocator* a, size_t ops) {
+    ptr_ring ring;
+    if (!ptr_ring_init(&ring, RING_CAPACITY, NULL)) return -1.0;
+    cross_thread_ctx ctx = { a, &ring, ops };
+    uint64_t rng = 0xd1b54a32d192ed03ULL;
+
+    double start = now_ns();
+    thread_t consumer = thread_create(cross_thread_consumer, &ctx);
+    for (size_t i = 0; i < ops; i++) {
+        void* ptr = a->alloc(NULL, next_size(&rng));
+        *(char*)ptr = (char)i;
+        while (!ptr_ring_push(&ring, ptr)) thread_yield();
+    }
+    thread_join(consumer);
+    double elapsed = now_ns() - start;
+
+    ptr_ring_free(&ring);
+    return elapsed / (double)ops;
+}
+
+int main(int argc, char** argv) {
+    size_t ops = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 2000000;
+    if (!ops) ops = 1;
+
+    printf("%zu ops per run, ns/op\n", ops);
+    printf("%-10s %10s %10s %12s\n", "allocator", "churn", "realloc", "cross-thread");
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++) {
+        const bench_allocator* a = &allocators[i];
+        double churn = bench_churn(a, ops);
+        double resize = bench_realloc(a, ops);
+        double cross = bench_cross_thread(a, ops);
+        printf("%-10s %10.1f %10.1f %12.1f\n", a->name, churn, resize, cross);
+    }
+    return 0;
+}
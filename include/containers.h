@@ -3,13 +3,108 @@
 
 #include "memory.h"
 #include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define _CONTAINER_SSE2 1
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* ------------------------------ Shared helpers ----------------------------- */
+/* Align is a compile-time constant in every expansion; 0 means the allocator's
+ * default alignment, so the branch folds away. */
+#define _CONTAINER_REALLOC(a, ptr, old_size, new_size, Align)                  \
+    ((Align) ? REALLOC_ALIGNED((a), (ptr), (old_size), (new_size), (Align))   \
+             : REALLOC((a), (ptr), (old_size), (new_size)))
+
+/* File-scope compile-time check usable inside the DEFINE macros */
+#ifdef __cplusplus
+    #define _CONTAINER_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+    #define _CONTAINER_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+/* Alignment for struct members, e.g. to keep hot fields on their own line */
+#if defined(__cplusplus)
+    #define _CONTAINER_ALIGNAS(n) alignas(n)
+#elif defined(_MSC_VER) && !defined(__clang__)
+    #define _CONTAINER_ALIGNAS(n) __declspec(align(n))
+#else
+    #define _CONTAINER_ALIGNAS(n) _Alignas(n)
+#endif
+
+/* Index of the lowest set bit; x must be non-zero. */
+static inline unsigned _container_ctz32(uint32_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(x);
+#endif
+}
+
+static inline unsigned _container_ctz64(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctzll(x);
+#endif
+}
+
+static inline unsigned _container_popcount64(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return (unsigned)__popcnt64(x);
+#else
+    return (unsigned)__builtin_popcountll(x);
+#endif
+}
+
+/* -------------------------- Hash functions --------------------------------- */
+/* Ready-made hash/eq pairs for HASHMAP_DEFINE. Hashes must mix well in both
+ * the low 7 bits and the high bits, since the map uses both. */
+static inline uint64_t hash_u64(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static inline uint64_t hash_ptr(const void *key) {
+    return hash_u64((uint64_t)(uintptr_t)key);
+}
+
+/* FNV-1a followed by a final mix */
+static inline uint64_t hash_string(const char *key) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 0x100000001b3ULL;
+    }
+    return hash_u64(h);
+}
+
+static inline bool eq_u64(uint64_t a, uint64_t b) { return a == b; }
+static inline bool eq_ptr(const void *a, const void *b) { return a == b; }
+static inline bool eq_string(const char *a, const char *b) { return strcmp(a, b) == 0; }
+
 /* -------------------------- Vector Definition Macro ------------------------ */
-#define VECTOR_DEFINE(T, Name)                                                 \
+#define VECTOR_DEFINE(T, Name) VECTOR_DEFINE_ALIGNED(T, Name, 0)
+
+/* Same as VECTOR_DEFINE, but data is aligned to Align bytes (e.g. 32, 64 or
+ * CACHE_LINE_SIZE) so vectorized loops over it get aligned loads. */
+#define VECTOR_DEFINE_ALIGNED(T, Name, Align)                                  \
 typedef struct {                                                               \
     T *data;                                                                   \
     size_t length;                                                             \
@@ -31,18 +126,85 @@ static inline void Name##_free(Name *vec) {                                    \
     vec->capacity = 0;                                                         \
 }                                                                              \
                                                                                \
+/* Reallocate to exactly capacity elements (capacity >= length) */             \
+static inline bool Name##_set_capacity(Name *vec, size_t capacity) {           \
+    T* new_data = _CONTAINER_REALLOC(vec->alloc, vec->data, vec->capacity * sizeof(T), capacity * sizeof(T), Align); \
+    if (!new_data && capacity) return false;                                   \
+    vec->data = new_data;                                                      \
+    vec->capacity = capacity;                                                  \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Grow geometrically to hold at least min_capacity elements */                \
+static inline bool Name##_grow(Name *vec, size_t min_capacity) {               \
+    size_t new_capacity = vec->capacity ? vec->capacity * 2 : 4;               \
+    if (new_capacity < min_capacity) new_capacity = min_capacity;              \
+    return Name##_set_capacity(vec, new_capacity);                             \
+}                                                                              \
+                                                                               \
+static inline bool Name##_reserve(Name *vec, size_t capacity) {                \
+    if (capacity <= vec->capacity) return true;                                \
+    return Name##_set_capacity(vec, capacity);                                 \
+}                                                                              \
+                                                                               \
+static inline bool Name##_shrink_to_fit(Name *vec) {                           \
+    if (vec->length == vec->capacity) return true;                             \
+    return Name##_set_capacity(vec, vec->length);                              \
+}                                                                              \
+                                                                               \
 static inline bool Name##_push(Name *vec, T value) {                           \
-    if (vec->length >= vec->capacity) {                                        \
-        size_t new_capacity = vec->capacity ? vec->capacity * 2 : 4;           \
-        T* new_data = REALLOC(vec->alloc, vec->data, vec->capacity * sizeof(T), new_capacity * sizeof(T)); \
-        if (!new_data) return false;                                           \
-        vec->data = new_data;                                                  \
-        vec->capacity = new_capacity;                                          \
-    }                                                                          \
+    if (vec->length >= vec->capacity && !Name##_grow(vec, vec->length + 1)) return false; \
     vec->data[vec->length++] = value;                                          \
     return true;                                                               \
 }                                                                              \
                                                                                \
+/* Append count uninitialized elements and return a pointer to the first */    \
+static inline T* Name##_push_uninit(Name *vec, size_t count) {                 \
+    if (vec->capacity - vec->length < count && !Name##_grow(vec, vec->length + count)) return NULL; \
+    T *slot = vec->data + vec->length;                                         \
+    vec->length += count;                                                      \
+    return slot;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push_n(Name *vec, const T *values, size_t count) {   \
+    T *slot = Name##_push_uninit(vec, count);                                  \
+    if (!slot) return count == 0;                                              \
+    memcpy(slot, values, count * sizeof(T));                                   \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* New elements are zero-filled */                                             \
+static inline bool Name##_resize(Name *vec, size_t length) {                   \
+    if (length > vec->capacity && !Name##_grow(vec, length)) return false;     \
+    if (length > vec->length) memset(vec->data + vec->length, 0, (length - vec->length) * sizeof(T)); \
+    vec->length = length;                                                      \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_insert_n(Name *vec, size_t index, const T *values, size_t count) { \
+    if (index > vec->length) return false;                                     \
+    if (vec->capacity - vec->length < count && !Name##_grow(vec, vec->length + count)) return false; \
+    memmove(vec->data + index + count, vec->data + index, (vec->length - index) * sizeof(T)); \
+    memcpy(vec->data + index, values, count * sizeof(T));                      \
+    vec->length += count;                                                      \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_insert(Name *vec, size_t index, T value) {           \
+    return Name##_insert_n(vec, index, &value, 1);                             \
+}                                                                              \
+                                                                               \
+static inline bool Name##_erase_n(Name *vec, size_t index, size_t count) {     \
+    if (index > vec->length || count > vec->length - index) return false;      \
+    memmove(vec->data + index, vec->data + index + count, (vec->length - index - count) * sizeof(T)); \
+    vec->length -= count;                                                      \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_erase(Name *vec, size_t index) {                     \
+    return Name##_erase_n(vec, index, 1);                                      \
+}                                                                              \
+                                                                               \
 static inline bool Name##_pop(Name *vec, T *out) {                             \
     if (vec->length == 0) return false;                                        \
     if (out) *out = vec->data[vec->length - 1];                                \
@@ -66,6 +228,82 @@ static inline void Name##_delete(Name *vec) {                                  \
     vec->capacity = 0;                                                         \
 }
 
+/* ----------------------- Small Vector Definition Macro --------------------- */
+#define SMALL_VECTOR_DEFINE(T, N, Name)                                        \
+_CONTAINER_STATIC_ASSERT((N) > 0, "SMALL_VECTOR_DEFINE needs N > 0");          \
+typedef struct {                                                               \
+    T *heap;                                                                   \
+    size_t length;                                                             \
+    size_t capacity;                                                           \
+    allocator_t *alloc;                                                        \
+    T inline_data[N];                                                          \
+} Name;                                                                        \
+                                                                               \
+static inline void Name##_init(Name *vec, allocator_t *alloc) {                \
+    vec->heap = NULL;                                                          \
+    vec->length = 0;                                                           \
+    vec->capacity = N;                                                         \
+    vec->alloc = alloc ? alloc : &default_allocator;                           \
+}                                                                              \
+                                                                               \
+/* Element storage: inline until the vector outgrows N elements. The struct    \
+ * holds no pointer to itself, so it can be copied or moved with memcpy. */    \
+static inline T* Name##_data(Name *vec) {                                      \
+    return vec->heap ? vec->heap : vec->inline_data;                           \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *vec) {                                    \
+    if (vec->heap) FREE(vec->alloc, vec->heap);                                \
+    vec->heap = NULL;                                                          \
+    vec->length = 0;                                                           \
+    vec->capacity = N;                                                         \
+}                                                                              \
+                                                                               \
+static inline bool Name##_reserve(Name *vec, size_t capacity) {                \
+    if (capacity <= vec->capacity) return true;                                \
+    T *new_heap;                                                               \
+    if (vec->heap) {                                                           \
+        new_heap = REALLOC(vec->alloc, vec->heap, vec->capacity * sizeof(T), capacity * sizeof(T)); \
+        if (!new_heap) return false;                                           \
+    } else {                                                                   \
+        new_heap = ALLOC(vec->alloc, capacity * sizeof(T));                    \
+        if (!new_heap) return false;                                           \
+        memcpy(new_heap, vec->inline_data, vec->length * sizeof(T));           \
+    }                                                                          \
+    vec->heap = new_heap;                                                      \
+    vec->capacity = capacity;                                                  \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push(Name *vec, T value) {                           \
+    if (vec->length >= vec->capacity && !Name##_reserve(vec, vec->capacity * 2)) return false; \
+    Name##_data(vec)[vec->length++] = value;                                   \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop(Name *vec, T *out) {                             \
+    if (vec->length == 0) return false;                                        \
+    if (out) *out = Name##_data(vec)[vec->length - 1];                         \
+    vec->length--;                                                             \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline T* Name##_get(Name *vec, uint64_t index) {                       \
+    if (index >= vec->length) return NULL;                                     \
+    return &Name##_data(vec)[index];                                           \
+}                                                                              \
+                                                                               \
+static inline void Name##_delete(Name *vec) {                                  \
+    if (vec->alloc && vec->alloc->free_all) {                                  \
+        FREE_ALL(vec->alloc);                                                  \
+    } else if (vec->heap) {                                                    \
+        FREE(vec->alloc, vec->heap);                                           \
+    }                                                                          \
+    vec->heap = NULL;                                                          \
+    vec->length = 0;                                                           \
+    vec->capacity = N;                                                         \
+}
+
 /* ------------------------ Singly-linked List Macro ------------------------- */
 #define SL_LIST_DEFINE(T, Name)                                                \
 typedef struct Name##_node {                                                   \
@@ -154,6 +392,1758 @@ static inline void Name##_delete(Name *list) {                                 \
 }
 
 
+/* ------------------------- Chunked Deque Macro ----------------------------- */
+/* Unrolled list: each chunk stores many elements, so iteration mostly walks
+ * contiguous memory, and elements never move once pushed. */
+#define DEQUE_DEFINE(T, Name)                                                  \
+enum { Name##_chunk_capacity = sizeof(T) <= 128 ? 1024 / sizeof(T) : 8 };      \
+                                                                               \
+typedef struct Name##_chunk {                                                  \
+    struct Name##_chunk *prev;                                                 \
+    struct Name##_chunk *next;                                                 \
+    T items[Name##_chunk_capacity];                                            \
+} Name##_chunk;                                                                \
+                                                                               \
+typedef struct {                                                               \
+    Name##_chunk *head;                                                        \
+    Name##_chunk *tail;                                                        \
+    Name##_chunk *spare;                                                       \
+    size_t head_index;                                                         \
+    size_t tail_index;                                                         \
+    size_t length;                                                             \
+    allocator_t *alloc;                                                        \
+} Name;                                                                        \
+                                                                               \
+typedef struct {                                                               \
+    Name##_chunk *chunk;                                                       \
+    size_t index;                                                              \
+    size_t end;                                                                \
+    const Name *deque;                                                         \
+} Name##_iter;                                                                 \
+                                                                               \
+static inline void Name##_init(Name *dq, allocator_t *alloc) {                 \
+    dq->head = NULL;                                                           \
+    dq->tail = NULL;                                                           \
+    dq->spare = NULL;                                                          \
+    dq->head_index = 0;                                                        \
+    dq->tail_index = 0;                                                        \
+    dq->length = 0;                                                            \
+    dq->alloc = alloc ? alloc : &default_allocator;                            \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *dq) {                                     \
+    Name##_chunk *curr = dq->head;                                             \
+    while (curr) {                                                             \
+        Name##_chunk *next = curr->next;                                       \
+        FREE(dq->alloc, curr);                                                 \
+        curr = next;                                                           \
+    }                                                                          \
+    if (dq->spare) FREE(dq->alloc, dq->spare);                                 \
+    dq->head = NULL;                                                           \
+    dq->tail = NULL;                                                           \
+    dq->spare = NULL;                                                          \
+    dq->length = 0;                                                            \
+}                                                                              \
+                                                                               \
+/* One emptied chunk is kept back so a deque oscillating across a chunk        \
+ * boundary does not allocate on every push. */                                \
+static inline Name##_chunk* Name##_chunk_new(Name *dq) {                       \
+    Name##_chunk *chunk = dq->spare;                                           \
+    if (chunk) dq->spare = NULL;                                               \
+    else chunk = ALLOC(dq->alloc, sizeof(Name##_chunk));                       \
+    return chunk;                                                              \
+}                                                                              \
+                                                                               \
+static inline void Name##_chunk_release(Name *dq, Name##_chunk *chunk) {       \
+    if (dq->spare) FREE(dq->alloc, dq->spare);                                 \
+    dq->spare = chunk;                                                         \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push_back(Name *dq, T value) {                       \
+    if (!dq->tail || dq->tail_index == Name##_chunk_capacity) {                \
+        Name##_chunk *chunk = Name##_chunk_new(dq);                            \
+        if (!chunk) return false;                                              \
+        chunk->next = NULL;                                                    \
+        chunk->prev = dq->tail;                                                \
+        if (dq->tail) dq->tail->next = chunk;                                  \
+        else {                                                                 \
+            dq->head = chunk;                                                  \
+            dq->head_index = 0;                                                \
+        }                                                                      \
+        dq->tail = chunk;                                                      \
+        dq->tail_index = 0;                                                    \
+    }                                                                          \
+    dq->tail->items[dq->tail_index++] = value;                                 \
+    dq->length++;                                                              \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push_front(Name *dq, T value) {                      \
+    if (!dq->head || dq->head_index == 0) {                                    \
+        Name##_chunk *chunk = Name##_chunk_new(dq);                            \
+        if (!chunk) return false;                                              \
+        chunk->prev = NULL;                                                    \
+        chunk->next = dq->head;                                                \
+        if (dq->head) dq->head->prev = chunk;                                  \
+        else {                                                                 \
+            dq->tail = chunk;                                                  \
+            dq->tail_index = Name##_chunk_capacity;                            \
+        }                                                                      \
+        dq->head = chunk;                                                      \
+        dq->head_index = Name##_chunk_capacity;                                \
+    }                                                                          \
+    dq->head->items[--dq->head_index] = value;                                 \
+    dq->length++;                                                              \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop_front(Name *dq, T *out) {                        \
+    if (!dq->length) return false;                                             \
+    if (out) *out = dq->head->items[dq->head_index];                           \
+    dq->head_index++;                                                          \
+    if (--dq->length == 0) {                                                   \
+        Name##_chunk_release(dq, dq->head);                                    \
+        dq->head = NULL;                                                       \
+        dq->tail = NULL;                                                       \
+    } else if (dq->head_index == Name##_chunk_capacity) {                      \
+        Name##_chunk *chunk = dq->head;                                        \
+        dq->head = chunk->next;                                                \
+        dq->head->prev = NULL;                                                 \
+        dq->head_index = 0;                                                    \
+        Name##_chunk_release(dq, chunk);                                       \
+    }                                                                          \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop_back(Name *dq, T *out) {                         \
+    if (!dq->length) return false;                                             \
+    dq->tail_index--;                                                          \
+    if (out) *out = dq->tail->items[dq->tail_index];                           \
+    if (--dq->length == 0) {                                                   \
+        Name##_chunk_release(dq, dq->tail);                                    \
+        dq->head = NULL;                                                       \
+        dq->tail = NULL;                                                       \
+    } else if (dq->tail_index == 0) {                                          \
+        Name##_chunk *chunk = dq->tail;                                        \
+        dq->tail = chunk->prev;                                                \
+        dq->tail->next = NULL;                                                 \
+        dq->tail_index = Name##_chunk_capacity;                                \
+        Name##_chunk_release(dq, chunk);                                       \
+    }                                                                          \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline T* Name##_front(Name *dq) {                                      \
+    return dq->length ? &dq->head->items[dq->head_index] : NULL;               \
+}                                                                              \
+                                                                               \
+static inline T* Name##_back(Name *dq) {                                       \
+    return dq->length ? &dq->tail->items[dq->tail_index - 1] : NULL;           \
+}                                                                              \
+                                                                               \
+/* O(length / chunk capacity): walks chunks from the front */                  \
+static inline T* Name##_get(Name *dq, uint64_t index) {                        \
+    if (index >= dq->length) return NULL;                                      \
+    index += dq->head_index;                                                   \
+    Name##_chunk *chunk = dq->head;                                            \
+    while (index >= Name##_chunk_capacity) {                                   \
+        chunk = chunk->next;                                                   \
+        index -= Name##_chunk_capacity;                                        \
+    }                                                                          \
+    return &chunk->items[index];                                               \
+}                                                                              \
+                                                                               \
+/* Iterate with: Name##_iter it = Name##_begin(dq); while ((p = Name##_next(&it))) ... \
+ * Elements within a chunk are contiguous, so the inner steps are plain        \
+ * pointer increments. */                                                      \
+static inline Name##_iter Name##_begin(const Name *dq) {                       \
+    Name##_iter it;                                                            \
+    it.chunk = dq->head;                                                       \
+    it.index = dq->head_index;                                                 \
+    it.end = dq->head == dq->tail ? dq->tail_index : Name##_chunk_capacity;    \
+    it.deque = dq;                                                             \
+    return it;                                                                 \
+}                                                                              \
+                                                                               \
+static inline T* Name##_next(Name##_iter *it) {                                \
+    if (!it->chunk) return NULL;                                               \
+    if (it->index == it->end) {                                                \
+        if (it->chunk == it->deque->tail) return NULL;                         \
+        it->chunk = it->chunk->next;                                           \
+        it->index = 0;                                                         \
+        it->end = it->chunk == it->deque->tail ? it->deque->tail_index : Name##_chunk_capacity; \
+    }                                                                          \
+    return &it->chunk->items[it->index++];                                     \
+}                                                                              \
+                                                                               \
+static inline void Name##_delete(Name *dq) {                                   \
+    if (dq->alloc && dq->alloc->free_all) {                                    \
+        FREE_ALL(dq->alloc);                                                   \
+        dq->head = NULL;                                                       \
+        dq->tail = NULL;                                                       \
+        dq->spare = NULL;                                                      \
+        dq->length = 0;                                                        \
+    } else {                                                                   \
+        Name##_free(dq);                                                       \
+    }                                                                          \
+}
+
+/* ------------------------------ Ring buffer helpers ------------------------ */
+/* Capacities are rounded to a power of two so indices wrap with a mask. The
+ * head and tail counters grow forever and are only masked on access. Returns
+ * 0 when no power of two that large fits in a size_t. */
+static inline size_t _ring_capacity_for(size_t capacity) {
+    if (capacity > (SIZE_MAX >> 1) + 1) return 0;
+    size_t rounded = 2;
+    while (rounded < capacity) rounded *= 2;
+    return rounded;
+}
+
+/* ------------------------- SPSC Ring Buffer Macro -------------------------- */
+/* Bounded single-producer/single-consumer queue. Wait-free: each side does
+ * one acquire load at most and one release store per batch. Each side's
+ * fields start their own cache line, so a ring placed on the heap needs
+ * ALLOC_ALIGNED with CACHE_LINE_SIZE. */
+#define SPSC_RING_DEFINE(T, Name)                                              \
+typedef struct {                                                               \
+    T *buffer;                                                                 \
+    size_t mask;                                                               \
+    allocator_t *alloc;                                                        \
+    union {                                                                    \
+        struct {                                                               \
+            atomicsz_t tail;                                                   \
+            size_t cached_head;                                                \
+        };                                                                     \
+        _CONTAINER_ALIGNAS(CACHE_LINE_SIZE) char _pad_producer[CACHE_LINE_SIZE];\
+    } producer;                                                                \
+    union {                                                                    \
+        struct {                                                               \
+            atomicsz_t head;                                                   \
+            size_t cached_tail;                                                \
+        };                                                                     \
+        _CONTAINER_ALIGNAS(CACHE_LINE_SIZE) char _pad_consumer[CACHE_LINE_SIZE];\
+    } consumer;                                                                \
+} Name;                                                                        \
+                                                                               \
+static inline bool Name##_init(Name *ring, size_t capacity, allocator_t *alloc) { \
+    ring->alloc = alloc ? alloc : &default_allocator;                          \
+    capacity = _ring_capacity_for(capacity);                                   \
+    if (!capacity || capacity > SIZE_MAX / sizeof(T)) return false;            \
+    ring->buffer = ALLOC_PREFER_ALIGNED(ring->alloc, capacity * sizeof(T), CACHE_LINE_SIZE); \
+    if (!ring->buffer) return false;                                           \
+    ring->mask = capacity - 1;                                                 \
+    atomicsz_init(&ring->producer.tail, 0);                                    \
+    ring->producer.cached_head = 0;                                            \
+    atomicsz_init(&ring->consumer.head, 0);                                    \
+    ring->consumer.cached_tail = 0;                                            \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *ring) {                                   \
+    if (ring->buffer) FREE(ring->alloc, ring->buffer);                         \
+    ring->buffer = NULL;                                                       \
+}                                                                              \
+                                                                               \
+/* Producer side. Each side caches the other's index and only rereads it       \
+ * when the cached value says the ring is full (or empty). */                  \
+static inline size_t Name##_push_n(Name *ring, const T *values, size_t count) { \
+    size_t tail = atomicsz_load(&ring->producer.tail, MEMORY_ORDER_RELAXED);   \
+    size_t capacity = ring->mask + 1;                                          \
+    if (capacity - (tail - ring->producer.cached_head) < count) {              \
+        ring->producer.cached_head = atomicsz_load(&ring->consumer.head, MEMORY_ORDER_ACQUIRE); \
+    }                                                                          \
+    size_t room = capacity - (tail - ring->producer.cached_head);              \
+    if (count > room) count = room;                                            \
+    for (size_t i = 0; i < count; i++) ring->buffer[(tail + i) & ring->mask] = values[i]; \
+    atomicsz_store(&ring->producer.tail, tail + count, MEMORY_ORDER_RELEASE);  \
+    return count;                                                              \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push(Name *ring, T value) {                          \
+    return Name##_push_n(ring, &value, 1) == 1;                                \
+}                                                                              \
+                                                                               \
+/* Consumer side */                                                            \
+static inline size_t Name##_pop_n(Name *ring, T *out, size_t max) {            \
+    size_t head = atomicsz_load(&ring->consumer.head, MEMORY_ORDER_RELAXED);   \
+    if (ring->consumer.cached_tail - head < max) {                             \
+        ring->consumer.cached_tail = atomicsz_load(&ring->producer.tail, MEMORY_ORDER_ACQUIRE); \
+    }                                                                          \
+    size_t available = ring->consumer.cached_tail - head;                      \
+    if (max > available) max = available;                                      \
+    for (size_t i = 0; i < max; i++) out[i] = ring->buffer[(head + i) & ring->mask]; \
+    atomicsz_store(&ring->consumer.head, head + max, MEMORY_ORDER_RELEASE);    \
+    return max;                                                                \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop(Name *ring, T *out) {                            \
+    return Name##_pop_n(ring, out, 1) == 1;                                    \
+}                                                                              \
+                                                                               \
+/* Approximate when called concurrently with either side */                    \
+static inline size_t Name##_size(Name *ring) {                                 \
+    return atomicsz_load(&ring->producer.tail, MEMORY_ORDER_ACQUIRE)           \
+         - atomicsz_load(&ring->consumer.head, MEMORY_ORDER_ACQUIRE);          \
+}
+
+/* ------------------------- MPMC Queue Macro -------------------------------- */
+/* Bounded multi-producer/multi-consumer queue after Dmitry Vyukov's design:
+ * every cell carries a sequence number that tells producers and consumers
+ * whether it is theirs, so the only contended writes are the two CASed
+ * position counters, each aligned to its own cache line. */
+#define MPMC_QUEUE_DEFINE(T, Name)                                             \
+typedef struct {                                                               \
+    atomicsz_t sequence;                                                       \
+    T data;                                                                    \
+} Name##_cell;                                                                 \
+                                                                               \
+typedef struct {                                                               \
+    Name##_cell *cells;                                                        \
+    size_t mask;                                                               \
+    allocator_t *alloc;                                                        \
+    union {                                                                    \
+        atomicsz_t enqueue_pos;                                                \
+        _CONTAINER_ALIGNAS(CACHE_LINE_SIZE) char _pad_enqueue[CACHE_LINE_SIZE];\
+    };                                                                         \
+    union {                                                                    \
+        atomicsz_t dequeue_pos;                                                \
+        _CONTAINER_ALIGNAS(CACHE_LINE_SIZE) char _pad_dequeue[CACHE_LINE_SIZE];\
+    };                                                                         \
+} Name;                                                                        \
+                                                                               \
+static inline bool Name##_init(Name *q, size_t capacity, allocator_t *alloc) { \
+    q->alloc = alloc ? alloc : &default_allocator;                             \
+    capacity = _ring_capacity_for(capacity);                                   \
+    if (!capacity || capacity > SIZE_MAX / sizeof(Name##_cell)) return false;  \
+    q->cells = ALLOC_PREFER_ALIGNED(q->alloc, capacity * sizeof(Name##_cell), CACHE_LINE_SIZE); \
+    if (!q->cells) return false;                                               \
+    for (size_t i = 0; i < capacity; i++) atomicsz_init(&q->cells[i].sequence, i); \
+    q->mask = capacity - 1;                                                    \
+    atomicsz_init(&q->enqueue_pos, 0);                                         \
+    atomicsz_init(&q->dequeue_pos, 0);                                         \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *q) {                                      \
+    if (q->cells) FREE(q->alloc, q->cells);                                    \
+    q->cells = NULL;                                                           \
+}                                                                              \
+                                                                               \
+/* A cell is free for position pos when its sequence equals pos and holds      \
+ * data for pos when it equals pos + 1. Claim as many consecutive ready        \
+ * cells as possible (up to count) with one CAS, then fill them. */            \
+static inline size_t Name##_push_n(Name *q, const T *values, size_t count) {   \
+    if (count == 0) return 0;                                                  \
+    size_t pos = atomicsz_load(&q->enqueue_pos, MEMORY_ORDER_RELAXED);         \
+    size_t claimed;                                                            \
+    for (;;) {                                                                 \
+        claimed = 0;                                                           \
+        while (claimed < count && claimed <= q->mask) {                        \
+            size_t seq = atomicsz_load(&q->cells[(pos + claimed) & q->mask].sequence, MEMORY_ORDER_ACQUIRE); \
+            if (seq != pos + claimed) break;                                   \
+            claimed++;                                                         \
+        }                                                                      \
+        if (claimed == 0) {                                                    \
+            size_t seq = atomicsz_load(&q->cells[pos & q->mask].sequence, MEMORY_ORDER_ACQUIRE); \
+            if ((intptr_t)(seq - pos) < 0) return 0;                           \
+            pos = atomicsz_load(&q->enqueue_pos, MEMORY_ORDER_RELAXED);        \
+            continue;                                                          \
+        }                                                                      \
+        if (atomicsz_compare_exchange_weak(&q->enqueue_pos, &pos, pos + claimed, \
+                                           MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED)) break; \
+    }                                                                          \
+    for (size_t i = 0; i < claimed; i++) {                                     \
+        Name##_cell *cell = &q->cells[(pos + i) & q->mask];                    \
+        cell->data = values[i];                                                \
+        atomicsz_store(&cell->sequence, pos + i + 1, MEMORY_ORDER_RELEASE);    \
+    }                                                                          \
+    return claimed;                                                            \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push(Name *q, T value) {                             \
+    return Name##_push_n(q, &value, 1) == 1;                                   \
+}                                                                              \
+                                                                               \
+static inline size_t Name##_pop_n(Name *q, T *out, size_t max) {               \
+    if (max == 0) return 0;                                                    \
+    size_t pos = atomicsz_load(&q->dequeue_pos, MEMORY_ORDER_RELAXED);         \
+    size_t claimed;                                                            \
+    for (;;) {                                                                 \
+        claimed = 0;                                                           \
+        while (claimed < max && claimed <= q->mask) {                          \
+            size_t seq = atomicsz_load(&q->cells[(pos + claimed) & q->mask].sequence, MEMORY_ORDER_ACQUIRE); \
+            if (seq != pos + claimed + 1) break;                               \
+            claimed++;                                                         \
+        }                                                                      \
+        if (claimed == 0) {                                                    \
+            size_t seq = atomicsz_load(&q->cells[pos & q->mask].sequence, MEMORY_ORDER_ACQUIRE); \
+            if ((intptr_t)(seq - (pos + 1)) < 0) return 0;                     \
+            pos = atomicsz_load(&q->dequeue_pos, MEMORY_ORDER_RELAXED);        \
+            continue;                                                          \
+        }                                                                      \
+        if (atomicsz_compare_exchange_weak(&q->dequeue_pos, &pos, pos + claimed, \
+                                           MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED)) break; \
+    }                                                                          \
+    for (size_t i = 0; i < claimed; i++) {                                     \
+        Name##_cell *cell = &q->cells[(pos + i) & q->mask];                    \
+        out[i] = cell->data;                                                   \
+        atomicsz_store(&cell->sequence, pos + i + q->mask + 1, MEMORY_ORDER_RELEASE); \
+    }                                                                          \
+    return claimed;                                                            \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop(Name *q, T *out) {                               \
+    return Name##_pop_n(q, out, 1) == 1;                                       \
+}
+
+/* ------------------------- Hash Map Definition Macro ----------------------- */
+/* Open addressing with one control byte per slot: 0x80 marks an empty slot,
+ * otherwise it holds the low 7 bits of the key's hash. Lookups compare 16
+ * control bytes at a time (SSE2 when available) and only touch the entries
+ * whose byte matches. Probing is linear per slot, so removal shifts the
+ * following entries back instead of leaving tombstones. The control array
+ * carries a copy of its first 16 bytes at the end so a group load never has
+ * to wrap around. */
+#define _HASHMAP_GROUP 16
+#define _HASHMAP_EMPTY 0x80
+#define _HASHMAP_MIN_CAPACITY 16
+
+/* Bit i set when control byte i of the group equals h2 */
+static inline uint32_t _hashmap_group_match(const uint8_t *ctrl, uint8_t h2) {
+#ifdef _CONTAINER_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#else
+    uint32_t mask = 0;
+    for (unsigned i = 0; i < _HASHMAP_GROUP; i++) mask |= (uint32_t)(ctrl[i] == h2) << i;
+    return mask;
+#endif
+}
+
+/* Bit i set when slot i of the group is empty */
+static inline uint32_t _hashmap_group_empty(const uint8_t *ctrl) {
+#ifdef _CONTAINER_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    uint32_t mask = 0;
+    for (unsigned i = 0; i < _HASHMAP_GROUP; i++) mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+/* Smallest power-of-two capacity keeping count entries at or below a 3/4 load */
+static inline size_t _hashmap_capacity_for(size_t count) {
+    size_t capacity = _HASHMAP_MIN_CAPACITY;
+    while (capacity - capacity / 4 < count) capacity *= 2;
+    return capacity;
+}
+
+/* Requested capacity rounded up to a power of two that still fits length */
+static inline size_t _hashmap_round_capacity(size_t requested, size_t length) {
+    size_t capacity = _hashmap_capacity_for(length);
+    while (capacity < requested) capacity *= 2;
+    return capacity;
+}
+
+#define HASHMAP_DEFINE(K, V, Name, hash, eq)                                   \
+typedef struct {                                                               \
+    K key;                                                                     \
+    V value;                                                                   \
+} Name##_entry;                                                                \
+                                                                               \
+typedef struct {                                                               \
+    Name##_entry *entries;                                                     \
+    uint8_t *ctrl;                                                             \
+    size_t length;                                                             \
+    size_t capacity;                                                           \
+    allocator_t *alloc;                                                        \
+} Name;                                                                        \
+                                                                               \
+static inline void Name##_init(Name *map, allocator_t *alloc) {                \
+    map->entries = NULL;                                                       \
+    map->ctrl = NULL;                                                          \
+    map->length = 0;                                                           \
+    map->capacity = 0;                                                         \
+    map->alloc = alloc ? alloc : &default_allocator;                           \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *map) {                                    \
+    if (map->entries) FREE(map->alloc, map->entries);                          \
+    map->entries = NULL;                                                       \
+    map->ctrl = NULL;                                                          \
+    map->length = 0;                                                           \
+    map->capacity = 0;                                                         \
+}                                                                              \
+                                                                               \
+static inline void Name##_set_ctrl(Name *map, size_t index, uint8_t value) {   \
+    map->ctrl[index] = value;                                                  \
+    if (index < _HASHMAP_GROUP) map->ctrl[map->capacity + index] = value;      \
+}                                                                              \
+                                                                               \
+/* Slot holding key, or SIZE_MAX */                                            \
+static inline size_t Name##_find_index(const Name *map, K key, uint64_t h) {   \
+    if (!map->capacity) return SIZE_MAX;                                       \
+    size_t mask = map->capacity - 1;                                           \
+    size_t pos = (size_t)(h >> 7) & mask;                                      \
+    uint8_t h2 = (uint8_t)(h & 0x7f);                                          \
+    for (;;) {                                                                 \
+        const uint8_t *group = map->ctrl + pos;                                \
+        uint32_t empty = _hashmap_group_empty(group);                          \
+        uint32_t match = _hashmap_group_match(group, h2);                      \
+        if (empty) match &= (empty & (0u - empty)) - 1;                        \
+        while (match) {                                                        \
+            size_t index = (pos + _container_ctz32(match)) & mask;             \
+            if (eq(map->entries[index].key, key)) return index;                \
+            match &= match - 1;                                                \
+        }                                                                      \
+        if (empty) return SIZE_MAX;                                            \
+        pos = (pos + _HASHMAP_GROUP) & mask;                                   \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+/* First empty slot on key's probe sequence; the table must not be full */     \
+static inline size_t Name##_find_empty(const Name *map, uint64_t h) {          \
+    size_t mask = map->capacity - 1;                                           \
+    size_t pos = (size_t)(h >> 7) & mask;                                      \
+    for (;;) {                                                                 \
+        uint32_t empty = _hashmap_group_empty(map->ctrl + pos);                \
+        if (empty) return (pos + _container_ctz32(empty)) & mask;              \
+        pos = (pos + _HASHMAP_GROUP) & mask;                                   \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline bool Name##_rehash(Name *map, size_t new_capacity) {             \
+    new_capacity = _hashmap_round_capacity(new_capacity, map->length);         \
+    size_t entries_size = new_capacity * sizeof(Name##_entry);                 \
+    void *block = ALLOC(map->alloc, entries_size + new_capacity + _HASHMAP_GROUP); \
+    if (!block) return false;                                                  \
+                                                                               \
+    Name old = *map;                                                           \
+    map->entries = (Name##_entry *)block;                                      \
+    map->ctrl = (uint8_t *)block + entries_size;                               \
+    map->capacity = new_capacity;                                              \
+    memset(map->ctrl, _HASHMAP_EMPTY, new_capacity + _HASHMAP_GROUP);          \
+                                                                               \
+    for (size_t i = 0; i < old.capacity; i++) {                                \
+        if (old.ctrl[i] & _HASHMAP_EMPTY) continue;                            \
+        uint64_t h = hash(old.entries[i].key);                                 \
+        size_t index = Name##_find_empty(map, h);                              \
+        map->entries[index] = old.entries[i];                                  \
+        Name##_set_ctrl(map, index, (uint8_t)(h & 0x7f));                      \
+    }                                                                          \
+    if (old.entries) FREE(map->alloc, old.entries);                            \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_reserve(Name *map, size_t count) {                   \
+    if (count <= map->capacity - map->capacity / 4) return true;               \
+    return Name##_rehash(map, _hashmap_capacity_for(count));                   \
+}                                                                              \
+                                                                               \
+static inline V* Name##_get(const Name *map, K key) {                          \
+    size_t index = Name##_find_index(map, key, hash(key));                     \
+    return index == SIZE_MAX ? NULL : &map->entries[index].value;              \
+}                                                                              \
+                                                                               \
+static inline bool Name##_contains(const Name *map, K key) {                   \
+    return Name##_find_index(map, key, hash(key)) != SIZE_MAX;                 \
+}                                                                              \
+                                                                               \
+/* Insert key, or overwrite its value if it is already present */              \
+static inline bool Name##_put(Name *map, K key, V value) {                     \
+    uint64_t h = hash(key);                                                    \
+    size_t index = Name##_find_index(map, key, h);                             \
+    if (index != SIZE_MAX) {                                                   \
+        map->entries[index].value = value;                                     \
+        return true;                                                           \
+    }                                                                          \
+    if (!Name##_reserve(map, map->length + 1)) return false;                   \
+    index = Name##_find_empty(map, h);                                         \
+    map->entries[index].key = key;                                             \
+    map->entries[index].value = value;                                         \
+    Name##_set_ctrl(map, index, (uint8_t)(h & 0x7f));                          \
+    map->length++;                                                             \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Backward-shift deletion: pull later entries of the cluster into the hole    \
+ * whenever the hole lies on their probe path. */                              \
+static inline bool Name##_remove(Name *map, K key, V *out) {                   \
+    size_t hole = Name##_find_index(map, key, hash(key));                      \
+    if (hole == SIZE_MAX) return false;                                        \
+    if (out) *out = map->entries[hole].value;                                  \
+                                                                               \
+    size_t mask = map->capacity - 1;                                           \
+    size_t next = (hole + 1) & mask;                                           \
+    while (!(map->ctrl[next] & _HASHMAP_EMPTY)) {                              \
+        size_t home = (size_t)(hash(map->entries[next].key) >> 7) & mask;      \
+        if (((next - home) & mask) >= ((next - hole) & mask)) {                \
+            map->entries[hole] = map->entries[next];                           \
+            Name##_set_ctrl(map, hole, map->ctrl[next]);                       \
+            hole = next;                                                       \
+        }                                                                      \
+        next = (next + 1) & mask;                                              \
+    }                                                                          \
+    Name##_set_ctrl(map, hole, _HASHMAP_EMPTY);                                \
+    map->length--;                                                             \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_clear(Name *map) {                                   \
+    if (map->ctrl) memset(map->ctrl, _HASHMAP_EMPTY, map->capacity + _HASHMAP_GROUP); \
+    map->length = 0;                                                           \
+}                                                                              \
+                                                                               \
+/* Iterate with: size_t it = 0; while ((e = Name##_next(map, &it))) ... */     \
+static inline Name##_entry* Name##_next(const Name *map, size_t *it) {         \
+    while (*it < map->capacity) {                                              \
+        size_t index = (*it)++;                                                \
+        if (!(map->ctrl[index] & _HASHMAP_EMPTY)) return &map->entries[index]; \
+    }                                                                          \
+    return NULL;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_delete(Name *map) {                                  \
+    if (map->alloc && map->alloc->free_all) {                                  \
+        FREE_ALL(map->alloc);                                                  \
+    } else if (map->entries) {                                                 \
+        FREE(map->alloc, map->entries);                                        \
+    }                                                                          \
+    map->entries = NULL;                                                       \
+    map->ctrl = NULL;                                                          \
+    map->length = 0;                                                           \
+    map->capacity = 0;                                                         \
+}
+
+/* ------------------------- Struct-of-Arrays Macro -------------------------- */
+/* Field lists are given as (Type, name) pairs. The _SOA_FOREACH machinery
+ * applies a per-field macro to each pair; _SOA_EXPAND forces the extra scan
+ * MSVC's traditional preprocessor needs to split __VA_ARGS__. Up to 16 fields
+ * are supported. */
+#define SOA_MAX_FIELDS 16
+
+/* Every column starts on its own cache line, so per-field loops get aligned
+ * loads and writes to one column never share a line with another. Allocators
+ * that cannot align the block still work; the columns are then only aligned
+ * to MEM_DEFAULT_ALIGNMENT. */
+#define SOA_COLUMN_ALIGN CACHE_LINE_SIZE
+
+#define _SOA_EXPAND(x) x
+#define _SOA_CAT_(a, b) a##b
+#define _SOA_CAT(a, b) _SOA_CAT_(a, b)
+#define _SOA_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define _SOA_NARGS(...) _SOA_EXPAND(_SOA_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define _SOA_FOREACH(M, ...) _SOA_EXPAND(_SOA_CAT(_SOA_FOREACH_, _SOA_NARGS(__VA_ARGS__))(M, __VA_ARGS__))
+#define _SOA_FOREACH_1(M, x) M x
+#define _SOA_FOREACH_2(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_1(M, __VA_ARGS__))
+#define _SOA_FOREACH_3(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_2(M, __VA_ARGS__))
+#define _SOA_FOREACH_4(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_3(M, __VA_ARGS__))
+#define _SOA_FOREACH_5(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_4(M, __VA_ARGS__))
+#define _SOA_FOREACH_6(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_5(M, __VA_ARGS__))
+#define _SOA_FOREACH_7(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_6(M, __VA_ARGS__))
+#define _SOA_FOREACH_8(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_7(M, __VA_ARGS__))
+#define _SOA_FOREACH_9(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_8(M, __VA_ARGS__))
+#define _SOA_FOREACH_10(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_9(M, __VA_ARGS__))
+#define _SOA_FOREACH_11(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_10(M, __VA_ARGS__))
+#define _SOA_FOREACH_12(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_11(M, __VA_ARGS__))
+#define _SOA_FOREACH_13(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_12(M, __VA_ARGS__))
+#define _SOA_FOREACH_14(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_13(M, __VA_ARGS__))
+#define _SOA_FOREACH_15(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_14(M, __VA_ARGS__))
+#define _SOA_FOREACH_16(M, x, ...) M x _SOA_EXPAND(_SOA_FOREACH_15(M, __VA_ARGS__))
+
+/* Per-field pieces. They refer to the locals of the functions that use them
+ * (soa, index, capacity, cursor, columns, row), so fields cannot take those
+ * names. */
+#define _SOA_MEMBER(T, f) T *f;
+#define _SOA_ROW_MEMBER(T, f) T f;
+#define _SOA_PARAM(T, f) , T f
+#define _SOA_COLUMN_BYTES(T, f) + ALIGN_UP(capacity * sizeof(T), SOA_COLUMN_ALIGN)
+#define _SOA_PLACE(T, f)                                                       \
+    columns.f = (T*)cursor;                                                    \
+    if (soa->length) memcpy(columns.f, soa->f, soa->length * sizeof(T));       \
+    cursor += ALIGN_UP(capacity * sizeof(T), SOA_COLUMN_ALIGN);
+#define _SOA_COPY_POINTER(T, f) soa->f = columns.f;
+#define _SOA_STORE(T, f) soa->f[index] = f;
+#define _SOA_STORE_ROW(T, f) soa->f[index] = row->f;
+#define _SOA_LOAD_ROW(T, f) row->f = soa->f[index];
+#define _SOA_MOVE_LAST(T, f) soa->f[index] = soa->f[soa->length - 1];
+#define _SOA_CLEAR_POINTER(T, f) soa->f = NULL;
+#define _SOA_ZERO(T, f) memset(soa->f + soa->length, 0, (length - soa->length) * sizeof(T));
+
+#define SOA_DEFINE(Name, ...)                                                  \
+typedef struct {                                                               \
+    _SOA_FOREACH(_SOA_MEMBER, __VA_ARGS__)                                     \
+    void *block;                                                               \
+    size_t length;                                                             \
+    size_t capacity;                                                           \
+    allocator_t *alloc;                                                        \
+} Name;                                                                        \
+                                                                               \
+/* One element gathered from every column */                                   \
+typedef struct {                                                               \
+    _SOA_FOREACH(_SOA_ROW_MEMBER, __VA_ARGS__)                                 \
+} Name##_row;                                                                  \
+                                                                               \
+static inline void Name##_init(Name *soa, allocator_t *alloc) {                \
+    memset(soa, 0, sizeof(*soa));                                              \
+    soa->alloc = alloc ? alloc : &default_allocator;                           \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *soa) {                                    \
+    if (soa->block) FREE(soa->alloc, soa->block);                              \
+    _SOA_FOREACH(_SOA_CLEAR_POINTER, __VA_ARGS__)                              \
+    soa->block = NULL;                                                         \
+    soa->length = 0;                                                           \
+    soa->capacity = 0;                                                         \
+}                                                                              \
+                                                                               \
+/* All columns live in one block, so every resize is a single allocation       \
+ * and the columns always grow together. capacity must be >= length. */        \
+static inline bool Name##_set_capacity(Name *soa, size_t capacity) {           \
+    size_t bytes = 0 _SOA_FOREACH(_SOA_COLUMN_BYTES, __VA_ARGS__);             \
+    Name columns;                                                              \
+    void *block = NULL;                                                        \
+    if (capacity) {                                                            \
+        block = ALLOC_PREFER_ALIGNED(soa->alloc, bytes, SOA_COLUMN_ALIGN);     \
+        if (!block) return false;                                              \
+    }                                                                          \
+    char *cursor = (char*)block;                                               \
+    (void)cursor;                                                              \
+    _SOA_FOREACH(_SOA_PLACE, __VA_ARGS__)                                      \
+    if (soa->block) FREE(soa->alloc, soa->block);                              \
+    _SOA_FOREACH(_SOA_COPY_POINTER, __VA_ARGS__)                               \
+    soa->block = block;                                                        \
+    soa->capacity = capacity;                                                  \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_grow(Name *soa, size_t min_capacity) {               \
+    size_t new_capacity = soa->capacity ? soa->capacity * 2 : 16;              \
+    if (new_capacity < min_capacity) new_capacity = min_capacity;              \
+    return Name##_set_capacity(soa, new_capacity);                             \
+}                                                                              \
+                                                                               \
+static inline bool Name##_reserve(Name *soa, size_t capacity) {                \
+    if (capacity <= soa->capacity) return true;                                \
+    return Name##_set_capacity(soa, capacity);                                 \
+}                                                                              \
+                                                                               \
+static inline bool Name##_shrink_to_fit(Name *soa) {                           \
+    if (soa->length == soa->capacity) return true;                             \
+    return Name##_set_capacity(soa, soa->length);                              \
+}                                                                              \
+                                                                               \
+/* Takes one argument per field, in declaration order */                       \
+static inline bool Name##_push(Name *soa _SOA_FOREACH(_SOA_PARAM, __VA_ARGS__)) { \
+    if (soa->length >= soa->capacity && !Name##_grow(soa, soa->length + 1)) return false; \
+    size_t index = soa->length++;                                              \
+    _SOA_FOREACH(_SOA_STORE, __VA_ARGS__)                                      \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push_row(Name *soa, const Name##_row *row) {         \
+    if (soa->length >= soa->capacity && !Name##_grow(soa, soa->length + 1)) return false; \
+    size_t index = soa->length++;                                              \
+    _SOA_FOREACH(_SOA_STORE_ROW, __VA_ARGS__)                                  \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* New elements are zero-filled */                                             \
+static inline bool Name##_resize(Name *soa, size_t length) {                   \
+    if (length > soa->capacity && !Name##_grow(soa, length)) return false;     \
+    if (length > soa->length) {                                                \
+        _SOA_FOREACH(_SOA_ZERO, __VA_ARGS__)                                   \
+    }                                                                          \
+    soa->length = length;                                                      \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_get(Name *soa, size_t index, Name##_row *row) {      \
+    if (index >= soa->length) return false;                                    \
+    _SOA_FOREACH(_SOA_LOAD_ROW, __VA_ARGS__)                                   \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_set(Name *soa, size_t index, const Name##_row *row) { \
+    if (index >= soa->length) return false;                                    \
+    _SOA_FOREACH(_SOA_STORE_ROW, __VA_ARGS__)                                  \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* O(1) removal: the last element moves into index, so order is not kept */    \
+static inline bool Name##_remove_swap(Name *soa, size_t index) {               \
+    if (index >= soa->length) return false;                                    \
+    _SOA_FOREACH(_SOA_MOVE_LAST, __VA_ARGS__)                                  \
+    soa->length--;                                                             \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop(Name *soa, Name##_row *row) {                    \
+    if (soa->length == 0) return false;                                        \
+    size_t index = soa->length - 1;                                            \
+    if (row) {                                                                 \
+        _SOA_FOREACH(_SOA_LOAD_ROW, __VA_ARGS__)                               \
+    }                                                                          \
+    soa->length--;                                                             \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_clear(Name *soa) {                                   \
+    soa->length = 0;                                                           \
+}                                                                              \
+                                                                               \
+static inline void Name##_delete(Name *soa) {                                  \
+    if (soa->alloc && soa->alloc->free_all) {                                  \
+        FREE_ALL(soa->alloc);                                                  \
+    } else if (soa->block) {                                                   \
+        FREE(soa->alloc, soa->block);                                          \
+    }                                                                          \
+    _SOA_FOREACH(_SOA_CLEAR_POINTER, __VA_ARGS__)                              \
+    soa->block = NULL;                                                         \
+    soa->length = 0;                                                           \
+    soa->capacity = 0;                                                         \
+}
+
+/* ------------------------------- Bitset ------------------------------------ */
+/* Dynamic bitset packed into 64-bit words. Bits past `bits` in the last word
+ * are always kept zero so whole-word operations (count, and/or, iteration)
+ * never need masking.
+ *
+ * rank/select can use an optional index built by bitset_build_rank: one
+ * cumulative count per BITSET_RANK_WORDS words. Any mutation invalidates it
+ * and rank/select fall back to a linear scan until it is rebuilt. */
+#define BITSET_RANK_WORDS 8
+
+typedef struct {
+    uint64_t *words;
+    size_t bits;
+    size_t word_count;
+    size_t capacity;
+    uint64_t *rank;
+    size_t rank_count;
+    bool rank_valid;
+    allocator_t *alloc;
+} bitset_t;
+
+static inline size_t _bitset_words_for(size_t bits) {
+    return (bits + 63) / 64;
+}
+
+/* Clear the unused high bits of the last word */
+static inline void _bitset_trim(bitset_t *bs) {
+    if (bs->bits % 64) bs->words[bs->word_count - 1] &= (UINT64_C(1) << (bs->bits % 64)) - 1;
+}
+
+static inline void bitset_init(bitset_t *bs, allocator_t *alloc) {
+    memset(bs, 0, sizeof(*bs));
+    bs->alloc = alloc ? alloc : &default_allocator;
+}
+
+static inline void bitset_free(bitset_t *bs) {
+    if (bs->words) FREE(bs->alloc, bs->words);
+    if (bs->rank) FREE(bs->alloc, bs->rank);
+    bs->words = NULL;
+    bs->rank = NULL;
+    bs->bits = 0;
+    bs->word_count = 0;
+    bs->capacity = 0;
+    bs->rank_count = 0;
+    bs->rank_valid = false;
+}
+
+/* New bits are cleared */
+static inline bool bitset_resize(bitset_t *bs, size_t bits) {
+    size_t word_count = _bitset_words_for(bits);
+    if (word_count > bs->capacity) {
+        size_t capacity = bs->capacity * 2;
+        if (capacity < word_count) capacity = word_count;
+        uint64_t *words = (uint64_t*)REALLOC_PREFER_ALIGNED(bs->alloc, bs->words, bs->capacity * sizeof(uint64_t), capacity * sizeof(uint64_t), CACHE_LINE_SIZE);
+        if (!words) return false;
+        bs->words = words;
+        bs->capacity = capacity;
+    }
+    if (word_count > bs->word_count) memset(bs->words + bs->word_count, 0, (word_count - bs->word_count) * sizeof(uint64_t));
+    bs->bits = bits;
+    bs->word_count = word_count;
+    if (word_count) _bitset_trim(bs);
+    bs->rank_valid = false;
+    return true;
+}
+
+static inline bool bitset_test(const bitset_t *bs, size_t index) {
+    return (bs->words[index / 64] >> (index % 64)) & 1;
+}
+
+static inline void bitset_set(bitset_t *bs, size_t index) {
+    bs->words[index / 64] |= UINT64_C(1) << (index % 64);
+    bs->rank_valid = false;
+}
+
+static inline void bitset_clear(bitset_t *bs, size_t index) {
+    bs->words[index / 64] &= ~(UINT64_C(1) << (index % 64));
+    bs->rank_valid = false;
+}
+
+static inline void bitset_flip(bitset_t *bs, size_t index) {
+    bs->words[index / 64] ^= UINT64_C(1) << (index % 64);
+    bs->rank_valid = false;
+}
+
+static inline void bitset_assign(bitset_t *bs, size_t index, bool value) {
+    uint64_t mask = UINT64_C(1) << (index % 64);
+    bs->words[index / 64] = (bs->words[index / 64] & ~mask) | (value ? mask : 0);
+    bs->rank_valid = false;
+}
+
+static inline void bitset_set_all(bitset_t *bs) {
+    if (!bs->word_count) return;
+    memset(bs->words, 0xff, bs->word_count * sizeof(uint64_t));
+    _bitset_trim(bs);
+    bs->rank_valid = false;
+}
+
+static inline void bitset_clear_all(bitset_t *bs) {
+    if (bs->word_count) memset(bs->words, 0, bs->word_count * sizeof(uint64_t));
+    bs->rank_valid = false;
+}
+
+/* Four independent accumulators keep the popcount units busy */
+static inline size_t _bitset_count_words(const uint64_t *words, size_t count) {
+    size_t c0 = 0, c1 = 0, c2 = 0, c3 = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+        c0 += _container_popcount64(words[i]);
+        c1 += _container_popcount64(words[i + 1]);
+        c2 += _container_popcount64(words[i + 2]);
+        c3 += _container_popcount64(words[i + 3]);
+    }
+    for (; i < count; i++) c0 += _container_popcount64(words[i]);
+    return c0 + c1 + c2 + c3;
+}
+
+static inline size_t bitset_count(const bitset_t *bs) {
+    return _bitset_count_words(bs->words, bs->word_count);
+}
+
+/* Whole-bitset boolean ops, in place on dst. Only the bits both sets have
+ * are combined; for AND, dst bits beyond src's size are cleared. */
+static inline void bitset_and(bitset_t *dst, const bitset_t *src) {
+    size_t n = dst->word_count < src->word_count ? dst->word_count : src->word_count;
+    for (size_t i = 0; i < n; i++) dst->words[i] &= src->words[i];
+    if (dst->word_count > n) memset(dst->words + n, 0, (dst->word_count - n) * sizeof(uint64_t));
+    dst->rank_valid = false;
+}
+
+static inline void bitset_or(bitset_t *dst, const bitset_t *src) {
+    size_t n = dst->word_count < src->word_count ? dst->word_count : src->word_count;
+    for (size_t i = 0; i < n; i++) dst->words[i] |= src->words[i];
+    if (n) _bitset_trim(dst);
+    dst->rank_valid = false;
+}
+
+static inline void bitset_xor(bitset_t *dst, const bitset_t *src) {
+    size_t n = dst->word_count < src->word_count ? dst->word_count : src->word_count;
+    for (size_t i = 0; i < n; i++) dst->words[i] ^= src->words[i];
+    if (n) _bitset_trim(dst);
+    dst->rank_valid = false;
+}
+
+/* dst &= ~src */
+static inline void bitset_andnot(bitset_t *dst, const bitset_t *src) {
+    size_t n = dst->word_count < src->word_count ? dst->word_count : src->word_count;
+    for (size_t i = 0; i < n; i++) dst->words[i] &= ~src->words[i];
+    dst->rank_valid = false;
+}
+
+/**
+ * @brief Find the first set bit at or after from.
+ * @return Its index, or bs->bits if there is none. Iterate with
+ *         for (i = bitset_next_set(bs, 0); i < bs->bits; i = bitset_next_set(bs, i + 1))
+ */
+static inline size_t bitset_next_set(const bitset_t *bs, size_t from) {
+    if (from >= bs->bits) return bs->bits;
+    size_t w = from / 64;
+    uint64_t word = bs->words[w] & (~UINT64_C(0) << (from % 64));
+    while (!word) {
+        if (++w >= bs->word_count) return bs->bits;
+        word = bs->words[w];
+    }
+    return w * 64 + _container_ctz64(word);
+}
+
+static inline size_t bitset_next_clear(const bitset_t *bs, size_t from) {
+    if (from >= bs->bits) return bs->bits;
+    size_t w = from / 64;
+    uint64_t word = ~bs->words[w] & (~UINT64_C(0) << (from % 64));
+    while (!word) {
+        if (++w >= bs->word_count) return bs->bits;
+        word = ~bs->words[w];
+    }
+    size_t index = w * 64 + _container_ctz64(word);
+    return index < bs->bits ? index : bs->bits;
+}
+
+/* rank[i] is the number of set bits before word i * BITSET_RANK_WORDS */
+static inline bool bitset_build_rank(bitset_t *bs) {
+    size_t rank_count = (bs->word_count + BITSET_RANK_WORDS - 1) / BITSET_RANK_WORDS + 1;
+    if (rank_count != bs->rank_count) {
+        uint64_t *rank = (uint64_t*)REALLOC(bs->alloc, bs->rank, bs->rank_count * sizeof(uint64_t), rank_count * sizeof(uint64_t));
+        if (!rank) return false;
+        bs->rank = rank;
+        bs->rank_count = rank_count;
+    }
+    uint64_t total = 0;
+    for (size_t i = 0; i < rank_count; i++) {
+        bs->rank[i] = total;
+        size_t start = i * BITSET_RANK_WORDS;
+        if (start < bs->word_count) {
+            size_t n = bs->word_count - start < BITSET_RANK_WORDS ? bs->word_count - start : BITSET_RANK_WORDS;
+            total += _bitset_count_words(bs->words + start, n);
+        }
+    }
+    bs->rank_valid = true;
+    return true;
+}
+
+/** @brief Number of set bits in [0, index). */
+static inline size_t bitset_rank(const bitset_t *bs, size_t index) {
+    if (index > bs->bits) index = bs->bits;
+    size_t w = index / 64;
+    size_t count, start = 0;
+    if (bs->rank_valid) {
+        count = bs->rank[w / BITSET_RANK_WORDS];
+        start = w / BITSET_RANK_WORDS * BITSET_RANK_WORDS;
+    } else {
+        count = 0;
+    }
+    count += _bitset_count_words(bs->words + start, w - start);
+    if (index % 64) count += _container_popcount64(bs->words[w] & ((UINT64_C(1) << (index % 64)) - 1));
+    return count;
+}
+
+/* Position of the k-th (0-based) set bit within one word */
+static inline unsigned _bitset_select_word(uint64_t word, unsigned k) {
+    while (k--) word &= word - 1;
+    return _container_ctz64(word);
+}
+
+/**
+ * @brief Find the k-th (0-based) set bit.
+ * @return Its index, or bs->bits if fewer than k + 1 bits are set.
+ */
+static inline size_t bitset_select(const bitset_t *bs, size_t k) {
+    size_t w = 0;
+    if (bs->rank_valid) {
+        /* Last block whose starting rank is <= k */
+        size_t lo = 0, hi = bs->rank_count - 1;
+        if (k >= bs->rank[hi]) return bs->bits;
+        while (lo + 1 < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (bs->rank[mid] <= k) lo = mid; else hi = mid;
+        }
+        k -= bs->rank[lo];
+        w = lo * BITSET_RANK_WORDS;
+    }
+    for (; w < bs->word_count; w++) {
+        unsigned c = _container_popcount64(bs->words[w]);
+        if (k < c) return w * 64 + _bitset_select_word(bs->words[w], (unsigned)k);
+        k -= c;
+    }
+    return bs->bits;
+}
+
+static inline void bitset_delete(bitset_t *bs) {
+    if (bs->alloc && bs->alloc->free_all) {
+        FREE_ALL(bs->alloc);
+    } else {
+        if (bs->words) FREE(bs->alloc, bs->words);
+        if (bs->rank) FREE(bs->alloc, bs->rank);
+    }
+    bs->words = NULL;
+    bs->rank = NULL;
+    bs->bits = 0;
+    bs->word_count = 0;
+    bs->capacity = 0;
+    bs->rank_count = 0;
+    bs->rank_valid = false;
+}
+
+/* ------------------------------- Heap Macro -------------------------------- */
+/* d-ary min-heap over contiguous storage. cmp(a, b) returns < 0 when a should
+ * come out first, so a max-heap just flips the comparison. Four children per
+ * node by default: a sift-down step then reads one 4-element run, which is
+ * typically a single cache line, and the tree is half as deep as a binary
+ * heap. */
+#define HEAP_DEFINE(T, Name, cmp) HEAP_DEFINE_D(T, Name, cmp, 4)
+
+#define HEAP_DEFINE_D(T, Name, cmp, D)                                         \
+typedef struct {                                                               \
+    T *data;                                                                   \
+    size_t length;                                                             \
+    size_t capacity;                                                           \
+    allocator_t *alloc;                                                        \
+} Name;                                                                        \
+                                                                               \
+static inline void Name##_init(Name *heap, allocator_t *alloc) {               \
+    heap->data = NULL;                                                         \
+    heap->length = 0;                                                          \
+    heap->capacity = 0;                                                        \
+    heap->alloc = alloc ? alloc : &default_allocator;                          \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *heap) {                                   \
+    if (heap->data) FREE(heap->alloc, heap->data);                             \
+    heap->data = NULL;                                                         \
+    heap->length = 0;                                                          \
+    heap->capacity = 0;                                                        \
+}                                                                              \
+                                                                               \
+static inline bool Name##_reserve(Name *heap, size_t capacity) {               \
+    if (capacity <= heap->capacity) return true;                               \
+    T *new_data = (T*)REALLOC(heap->alloc, heap->data, heap->capacity * sizeof(T), capacity * sizeof(T)); \
+    if (!new_data) return false;                                               \
+    heap->data = new_data;                                                     \
+    heap->capacity = capacity;                                                 \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Both sifts move a hole instead of swapping, one store per level */          \
+static inline void Name##_sift_up(Name *heap, size_t index) {                  \
+    T value = heap->data[index];                                               \
+    while (index > 0) {                                                        \
+        size_t parent = (index - 1) / (D);                                     \
+        if (cmp(value, heap->data[parent]) >= 0) break;                        \
+        heap->data[index] = heap->data[parent];                                \
+        index = parent;                                                        \
+    }                                                                          \
+    heap->data[index] = value;                                                 \
+}                                                                              \
+                                                                               \
+static inline void Name##_sift_down(Name *heap, size_t index) {                \
+    T value = heap->data[index];                                               \
+    for (;;) {                                                                 \
+        size_t first = index * (D) + 1;                                        \
+        if (first >= heap->length) break;                                      \
+        size_t last = first + (D) < heap->length ? first + (D) : heap->length; \
+        size_t best = first;                                                   \
+        for (size_t child = first + 1; child < last; child++) {                \
+            if (cmp(heap->data[child], heap->data[best]) < 0) best = child;    \
+        }                                                                      \
+        if (cmp(heap->data[best], value) >= 0) break;                          \
+        heap->data[index] = heap->data[best];                                  \
+        index = best;                                                          \
+    }                                                                          \
+    heap->data[index] = value;                                                 \
+}                                                                              \
+                                                                               \
+static inline bool Name##_push(Name *heap, T value) {                          \
+    if (heap->length >= heap->capacity) {                                      \
+        size_t capacity = heap->capacity ? heap->capacity * 2 : 8;             \
+        if (!Name##_reserve(heap, capacity)) return false;                     \
+    }                                                                          \
+    heap->data[heap->length] = value;                                          \
+    Name##_sift_up(heap, heap->length++);                                      \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline T* Name##_peek(Name *heap) {                                     \
+    return heap->length ? &heap->data[0] : NULL;                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop(Name *heap, T *out) {                            \
+    if (heap->length == 0) return false;                                       \
+    if (out) *out = heap->data[0];                                             \
+    if (--heap->length) {                                                      \
+        heap->data[0] = heap->data[heap->length];                              \
+        Name##_sift_down(heap, 0);                                             \
+    }                                                                          \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Replace the contents with count values and build the heap bottom-up in O(n) */ \
+static inline bool Name##_heapify(Name *heap, const T *values, size_t count) { \
+    if (!Name##_reserve(heap, count)) return false;                            \
+    if (count) memcpy(heap->data, values, count * sizeof(T));                  \
+    heap->length = count;                                                      \
+    if (count > 1) {                                                           \
+        for (size_t i = (count - 2) / (D) + 1; i-- > 0;) Name##_sift_down(heap, i); \
+    }                                                                          \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_clear(Name *heap) {                                  \
+    heap->length = 0;                                                          \
+}                                                                              \
+                                                                               \
+static inline void Name##_delete(Name *heap) {                                 \
+    if (heap->alloc && heap->alloc->free_all) {                                \
+        FREE_ALL(heap->alloc);                                                 \
+    } else if (heap->data) {                                                   \
+        FREE(heap->alloc, heap->data);                                         \
+    }                                                                          \
+    heap->data = NULL;                                                         \
+    heap->length = 0;                                                          \
+    heap->capacity = 0;                                                        \
+}
+
+/* --------------------------- Indexed Heap Macro ---------------------------- */
+/* Heap whose entries are addressed by a caller-chosen id (0, 1, 2, ...), for
+ * timer wheels and Dijkstra-style searches that need to change the priority
+ * of an entry already queued. positions[id] tracks where each id sits in the
+ * heap, or INDEXED_HEAP_NONE when it is not queued; the table grows to the
+ * largest id pushed. */
+#define INDEXED_HEAP_NONE SIZE_MAX
+#define INDEXED_HEAP_DEFINE(T, Name, cmp) INDEXED_HEAP_DEFINE_D(T, Name, cmp, 4)
+
+#define INDEXED_HEAP_DEFINE_D(T, Name, cmp, D)                                 \
+typedef struct {                                                               \
+    T value;                                                                   \
+    size_t id;                                                                 \
+} Name##_entry;                                                                \
+                                                                               \
+typedef struct {                                                               \
+    Name##_entry *data;                                                        \
+    size_t *positions;                                                         \
+    size_t length;                                                             \
+    size_t capacity;                                                           \
+    size_t id_capacity;                                                        \
+    allocator_t *alloc;                                                        \
+} Name;                                                                        \
+                                                                               \
+static inline void Name##_init(Name *heap, allocator_t *alloc) {               \
+    heap->data = NULL;                                                         \
+    heap->positions = NULL;                                                    \
+    heap->length = 0;                                                          \
+    heap->capacity = 0;                                                        \
+    heap->id_capacity = 0;                                                     \
+    heap->alloc = alloc ? alloc : &default_allocator;                          \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *heap) {                                   \
+    if (heap->data) FREE(heap->alloc, heap->data);                             \
+    if (heap->positions) FREE(heap->alloc, heap->positions);                   \
+    heap->data = NULL;                                                         \
+    heap->positions = NULL;                                                    \
+    heap->length = 0;                                                          \
+    heap->capacity = 0;                                                        \
+    heap->id_capacity = 0;                                                     \
+}                                                                              \
+                                                                               \
+/* Make room for ids below id_count and for capacity queued entries */         \
+static inline bool Name##_reserve(Name *heap, size_t capacity, size_t id_count) { \
+    if (capacity > heap->capacity) {                                           \
+        Name##_entry *new_data = (Name##_entry*)REALLOC(heap->alloc, heap->data, heap->capacity * sizeof(Name##_entry), capacity * sizeof(Name##_entry)); \
+        if (!new_data) return false;                                           \
+        heap->data = new_data;                                                 \
+        heap->capacity = capacity;                                             \
+    }                                                                          \
+    if (id_count > heap->id_capacity) {                                        \
+        size_t *new_positions = (size_t*)REALLOC(heap->alloc, heap->positions, heap->id_capacity * sizeof(size_t), id_count * sizeof(size_t)); \
+        if (!new_positions) return false;                                      \
+        for (size_t i = heap->id_capacity; i < id_count; i++) new_positions[i] = INDEXED_HEAP_NONE; \
+        heap->positions = new_positions;                                       \
+        heap->id_capacity = id_count;                                          \
+    }                                                                          \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_sift_up(Name *heap, size_t index) {                  \
+    Name##_entry entry = heap->data[index];                                    \
+    while (index > 0) {                                                        \
+        size_t parent = (index - 1) / (D);                                     \
+        if (cmp(entry.value, heap->data[parent].value) >= 0) break;            \
+        heap->data[index] = heap->data[parent];                                \
+        heap->positions[heap->data[index].id] = index;                         \
+        index = parent;                                                        \
+    }                                                                          \
+    heap->data[index] = entry;                                                 \
+    heap->positions[entry.id] = index;                                         \
+}                                                                              \
+                                                                               \
+static inline void Name##_sift_down(Name *heap, size_t index) {                \
+    Name##_entry entry = heap->data[index];                                    \
+    for (;;) {                                                                 \
+        size_t first = index * (D) + 1;                                        \
+        if (first >= heap->length) break;                                      \
+        size_t last = first + (D) < heap->length ? first + (D) : heap->length; \
+        size_t best = first;                                                   \
+        for (size_t child = first + 1; child < last; child++) {                \
+            if (cmp(heap->data[child].value, heap->data[best].value) < 0) best = child; \
+        }                                                                      \
+        if (cmp(heap->data[best].value, entry.value) >= 0) break;              \
+        heap->data[index] = heap->data[best];                                  \
+        heap->positions[heap->data[index].id] = index;                         \
+        index = best;                                                          \
+    }                                                                          \
+    heap->data[index] = entry;                                                 \
+    heap->positions[entry.id] = index;                                         \
+}                                                                              \
+                                                                               \
+static inline bool Name##_contains(const Name *heap, size_t id) {              \
+    return id < heap->id_capacity && heap->positions[id] != INDEXED_HEAP_NONE; \
+}                                                                              \
+                                                                               \
+/* Fails if id is already queued; use update or decrease_key for that */       \
+static inline bool Name##_push(Name *heap, size_t id, T value) {               \
+    if (Name##_contains(heap, id)) return false;                               \
+    if (heap->length >= heap->capacity || id >= heap->id_capacity) {           \
+        size_t capacity = heap->length < heap->capacity ? heap->capacity : (heap->capacity ? heap->capacity * 2 : 8); \
+        size_t id_count = heap->id_capacity;                                   \
+        if (id >= id_count) id_count = id_count * 2 > id + 1 ? id_count * 2 : id + 1; \
+        if (!Name##_reserve(heap, capacity, id_count)) return false;           \
+    }                                                                          \
+    heap->data[heap->length].value = value;                                    \
+    heap->data[heap->length].id = id;                                          \
+    Name##_sift_up(heap, heap->length++);                                      \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_peek(const Name *heap, size_t *id, T *value) {       \
+    if (heap->length == 0) return false;                                       \
+    if (id) *id = heap->data[0].id;                                            \
+    if (value) *value = heap->data[0].value;                                   \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline T* Name##_get(Name *heap, size_t id) {                           \
+    if (!Name##_contains(heap, id)) return NULL;                               \
+    return &heap->data[heap->positions[id]].value;                             \
+}                                                                              \
+                                                                               \
+/* Take out the entry at heap position index */                                \
+static inline void Name##_remove_at(Name *heap, size_t index) {                \
+    heap->positions[heap->data[index].id] = INDEXED_HEAP_NONE;                 \
+    if (index == --heap->length) return;                                       \
+    heap->data[index] = heap->data[heap->length];                              \
+    heap->positions[heap->data[index].id] = index;                             \
+    if (index > 0 && cmp(heap->data[index].value, heap->data[(index - 1) / (D)].value) < 0) { \
+        Name##_sift_up(heap, index);                                           \
+    } else {                                                                   \
+        Name##_sift_down(heap, index);                                         \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline bool Name##_pop(Name *heap, size_t *id, T *value) {              \
+    if (!Name##_peek(heap, id, value)) return false;                           \
+    Name##_remove_at(heap, 0);                                                 \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_remove(Name *heap, size_t id) {                      \
+    if (!Name##_contains(heap, id)) return false;                              \
+    Name##_remove_at(heap, heap->positions[id]);                               \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* value must not order after the current one; only sifts up */                \
+static inline bool Name##_decrease_key(Name *heap, size_t id, T value) {       \
+    if (!Name##_contains(heap, id)) return false;                              \
+    size_t index = heap->positions[id];                                        \
+    heap->data[index].value = value;                                           \
+    Name##_sift_up(heap, index);                                               \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Change the priority in either direction */                                  \
+static inline bool Name##_update(Name *heap, size_t id, T value) {             \
+    if (!Name##_contains(heap, id)) return false;                              \
+    size_t index = heap->positions[id];                                        \
+    heap->data[index].value = value;                                           \
+    Name##_sift_up(heap, index);                                               \
+    Name##_sift_down(heap, heap->positions[id]);                               \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_clear(Name *heap) {                                  \
+    for (size_t i = 0; i < heap->length; i++) heap->positions[heap->data[i].id] = INDEXED_HEAP_NONE; \
+    heap->length = 0;                                                          \
+}                                                                              \
+                                                                               \
+static inline void Name##_delete(Name *heap) {                                 \
+    if (heap->alloc && heap->alloc->free_all) {                                \
+        FREE_ALL(heap->alloc);                                                 \
+    } else {                                                                   \
+        if (heap->data) FREE(heap->alloc, heap->data);                         \
+        if (heap->positions) FREE(heap->alloc, heap->positions);               \
+    }                                                                          \
+    heap->data = NULL;                                                         \
+    heap->positions = NULL;                                                    \
+    heap->length = 0;                                                          \
+    heap->capacity = 0;                                                        \
+    heap->id_capacity = 0;                                                     \
+}
+
+/* ------------------------------ B+ Tree Macro ------------------------------ */
+/* Ordered map. Values live only in the leaves, which are chained left to
+ * right so range scans never climb back up the tree. Nodes hold enough keys
+ * to fill about four cache lines (at least 4), and leaves and inner nodes
+ * share one size, sizeof(Name##_node), so a pool_t allocator can serve every
+ * node. cmp(a, b) returns < 0, 0 or > 0.
+ *
+ * Inner node separators obey: keys in children[i] < keys[i] <= keys in
+ * children[i + 1]. Inserts split full nodes and removals refill minimal
+ * nodes on the way down, so neither ever walks back up. */
+#define BTREE_DEFINE(K, V, Name, cmp)                                          \
+enum { Name##_max_keys = sizeof(K) * 4 <= 256 ? (256 / sizeof(K)) & ~(size_t)1 : 4 }; \
+enum { Name##_min_keys = Name##_max_keys / 2 - 1 };                            \
+                                                                               \
+typedef struct Name##_node {                                                   \
+    uint32_t count;                                                            \
+    bool leaf;                                                                 \
+    K keys[Name##_max_keys];                                                   \
+    union {                                                                    \
+        struct Name##_node *children[Name##_max_keys + 1];                     \
+        struct {                                                               \
+            struct Name##_node *next;                                          \
+            V values[Name##_max_keys];                                         \
+        };                                                                     \
+    };                                                                         \
+} Name##_node;                                                                 \
+                                                                               \
+typedef struct {                                                               \
+    Name##_node *root;                                                         \
+    size_t length;                                                             \
+    allocator_t *alloc;                                                        \
+} Name;                                                                        \
+                                                                               \
+typedef struct {                                                               \
+    Name##_node *leaf;                                                         \
+    uint32_t index;                                                            \
+} Name##_iter;                                                                 \
+                                                                               \
+static inline void Name##_init(Name *tree, allocator_t *alloc) {               \
+    tree->root = NULL;                                                         \
+    tree->length = 0;                                                          \
+    tree->alloc = alloc ? alloc : &default_allocator;                          \
+}                                                                              \
+                                                                               \
+static inline Name##_node* Name##_node_new(Name *tree, bool leaf) {            \
+    Name##_node *node = (Name##_node*)ALLOC(tree->alloc, sizeof(Name##_node)); \
+    if (!node) return NULL;                                                    \
+    node->count = 0;                                                           \
+    node->leaf = leaf;                                                         \
+    if (leaf) node->next = NULL;                                               \
+    return node;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_free_subtree(Name *tree, Name##_node *node) {        \
+    if (!node->leaf) {                                                         \
+        for (uint32_t i = 0; i <= node->count; i++) Name##_free_subtree(tree, node->children[i]); \
+    }                                                                          \
+    FREE(tree->alloc, node);                                                   \
+}                                                                              \
+                                                                               \
+static inline void Name##_free(Name *tree) {                                   \
+    if (tree->root) Name##_free_subtree(tree, tree->root);                     \
+    tree->root = NULL;                                                         \
+    tree->length = 0;                                                          \
+}                                                                              \
+                                                                               \
+/* First index whose key is >= key */                                          \
+static inline uint32_t Name##_lower_index(const Name##_node *node, K key) {    \
+    uint32_t lo = 0, hi = node->count;                                         \
+    while (lo < hi) {                                                          \
+        uint32_t mid = (lo + hi) / 2;                                          \
+        if (cmp(node->keys[mid], key) < 0) lo = mid + 1; else hi = mid;        \
+    }                                                                          \
+    return lo;                                                                 \
+}                                                                              \
+                                                                               \
+/* First index whose key is > key; in an inner node, the child to descend */   \
+static inline uint32_t Name##_upper_index(const Name##_node *node, K key) {    \
+    uint32_t lo = 0, hi = node->count;                                         \
+    while (lo < hi) {                                                          \
+        uint32_t mid = (lo + hi) / 2;                                          \
+        if (cmp(node->keys[mid], key) <= 0) lo = mid + 1; else hi = mid;       \
+    }                                                                          \
+    return lo;                                                                 \
+}                                                                              \
+                                                                               \
+static inline Name##_node* Name##_find_leaf(const Name *tree, K key) {         \
+    Name##_node *node = tree->root;                                            \
+    if (!node) return NULL;                                                    \
+    while (!node->leaf) node = node->children[Name##_upper_index(node, key)];  \
+    return node;                                                               \
+}                                                                              \
+                                                                               \
+static inline V* Name##_get(const Name *tree, K key) {                         \
+    Name##_node *leaf = Name##_find_leaf(tree, key);                           \
+    if (!leaf) return NULL;                                                    \
+    uint32_t i = Name##_lower_index(leaf, key);                                \
+    if (i < leaf->count && cmp(leaf->keys[i], key) == 0) return &leaf->values[i]; \
+    return NULL;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_contains(const Name *tree, K key) {                  \
+    return Name##_get(tree, key) != NULL;                                      \
+}                                                                              \
+                                                                               \
+/* Split the full children[i] of parent in two. Nothing changes on failure. */ \
+static inline bool Name##_split_child(Name *tree, Name##_node *parent, uint32_t i) { \
+    Name##_node *child = parent->children[i];                                  \
+    Name##_node *right = Name##_node_new(tree, child->leaf);                   \
+    if (!right) return false;                                                  \
+    uint32_t mid = Name##_max_keys / 2;                                        \
+    K separator;                                                               \
+    if (child->leaf) {                                                         \
+        right->count = Name##_max_keys - mid;                                  \
+        memcpy(right->keys, child->keys + mid, right->count * sizeof(K));      \
+        memcpy(right->values, child->values + mid, right->count * sizeof(V));  \
+        right->next = child->next;                                             \
+        child->next = right;                                                   \
+        separator = right->keys[0];                                            \
+    } else {                                                                   \
+        separator = child->keys[mid];                                          \
+        right->count = Name##_max_keys - mid - 1;                              \
+        memcpy(right->keys, child->keys + mid + 1, right->count * sizeof(K));  \
+        memcpy(right->children, child->children + mid + 1, (right->count + 1) * sizeof(Name##_node*)); \
+    }                                                                          \
+    child->count = mid;                                                        \
+    memmove(parent->keys + i + 1, parent->keys + i, (parent->count - i) * sizeof(K)); \
+    memmove(parent->children + i + 2, parent->children + i + 1, (parent->count - i) * sizeof(Name##_node*)); \
+    parent->keys[i] = separator;                                               \
+    parent->children[i + 1] = right;                                           \
+    parent->count++;                                                           \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Insert or overwrite */                                                      \
+static inline bool Name##_put(Name *tree, K key, V value) {                    \
+    if (!tree->root && !(tree->root = Name##_node_new(tree, true))) return false; \
+    if (tree->root->count == Name##_max_keys) {                                \
+        Name##_node *root = Name##_node_new(tree, false);                      \
+        if (!root) return false;                                               \
+        root->children[0] = tree->root;                                        \
+        if (!Name##_split_child(tree, root, 0)) {                              \
+            FREE(tree->alloc, root);                                           \
+            return false;                                                      \
+        }                                                                      \
+        tree->root = root;                                                     \
+    }                                                                          \
+    Name##_node *node = tree->root;                                            \
+    while (!node->leaf) {                                                      \
+        uint32_t i = Name##_upper_index(node, key);                            \
+        if (node->children[i]->count == Name##_max_keys) {                     \
+            if (!Name##_split_child(tree, node, i)) return false;              \
+            if (cmp(key, node->keys[i]) >= 0) i++;                             \
+        }                                                                      \
+        node = node->children[i];                                              \
+    }                                                                          \
+    uint32_t i = Name##_lower_index(node, key);                                \
+    if (i < node->count && cmp(node->keys[i], key) == 0) {                     \
+        node->values[i] = value;                                               \
+        return true;                                                           \
+    }                                                                          \
+    memmove(node->keys + i + 1, node->keys + i, (node->count - i) * sizeof(K)); \
+    memmove(node->values + i + 1, node->values + i, (node->count - i) * sizeof(V)); \
+    node->keys[i] = key;                                                       \
+    node->values[i] = value;                                                   \
+    node->count++;                                                             \
+    tree->length++;                                                            \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Give children[i] of parent at least min_keys + 1 keys by borrowing from a   \
+ * sibling or merging with one. Returns the index of the child now covering    \
+ * the same key range. */                                                      \
+static inline uint32_t Name##_refill_child(Name *tree, Name##_node *parent, uint32_t i) { \
+    Name##_node *child = parent->children[i];                                  \
+    Name##_node *left = i > 0 ? parent->children[i - 1] : NULL;                \
+    Name##_node *right = i < parent->count ? parent->children[i + 1] : NULL;   \
+    if (left && left->count > Name##_min_keys) {                               \
+        memmove(child->keys + 1, child->keys, child->count * sizeof(K));       \
+        if (child->leaf) {                                                     \
+            memmove(child->values + 1, child->values, child->count * sizeof(V)); \
+            child->keys[0] = left->keys[left->count - 1];                      \
+            child->values[0] = left->values[left->count - 1];                  \
+            parent->keys[i - 1] = child->keys[0];                              \
+        } else {                                                               \
+            memmove(child->children + 1, child->children, (child->count + 1) * sizeof(Name##_node*)); \
+            child->keys[0] = parent->keys[i - 1];                              \
+            child->children[0] = left->children[left->count];                  \
+            parent->keys[i - 1] = left->keys[left->count - 1];                 \
+        }                                                                      \
+        left->count--;                                                         \
+        child->count++;                                                        \
+        return i;                                                              \
+    }                                                                          \
+    if (right && right->count > Name##_min_keys) {                             \
+        if (child->leaf) {                                                     \
+            child->keys[child->count] = right->keys[0];                        \
+            child->values[child->count] = right->values[0];                    \
+            memmove(right->values, right->values + 1, (right->count - 1) * sizeof(V)); \
+            memmove(right->keys, right->keys + 1, (right->count - 1) * sizeof(K)); \
+            parent->keys[i] = right->keys[0];                                  \
+        } else {                                                               \
+            child->keys[child->count] = parent->keys[i];                       \
+            child->children[child->count + 1] = right->children[0];            \
+            parent->keys[i] = right->keys[0];                                  \
+            memmove(right->keys, right->keys + 1, (right->count - 1) * sizeof(K)); \
+            memmove(right->children, right->children + 1, right->count * sizeof(Name##_node*)); \
+        }                                                                      \
+        right->count--;                                                        \
+        child->count++;                                                        \
+        return i;                                                              \
+    }                                                                          \
+    /* Both neighbours are minimal: merge children[i] and children[i + 1] */   \
+    if (left) i--;                                                             \
+    left = parent->children[i];                                                \
+    right = parent->children[i + 1];                                           \
+    if (left->leaf) {                                                          \
+        memcpy(left->keys + left->count, right->keys, right->count * sizeof(K)); \
+        memcpy(left->values + left->count, right->values, right->count * sizeof(V)); \
+        left->count += right->count;                                           \
+        left->next = right->next;                                              \
+    } else {                                                                   \
+        left->keys[left->count] = parent->keys[i];                             \
+        memcpy(left->keys + left->count + 1, right->keys, right->count * sizeof(K)); \
+        memcpy(left->children + left->count + 1, right->children, (right->count + 1) * sizeof(Name##_node*)); \
+        left->count += right->count + 1;                                       \
+    }                                                                          \
+    memmove(parent->keys + i, parent->keys + i + 1, (parent->count - i - 1) * sizeof(K)); \
+    memmove(parent->children + i + 1, parent->children + i + 2, (parent->count - i - 1) * sizeof(Name##_node*)); \
+    parent->count--;                                                           \
+    FREE(tree->alloc, right);                                                  \
+    return i;                                                                  \
+}                                                                              \
+                                                                               \
+static inline bool Name##_remove(Name *tree, K key) {                          \
+    Name##_node *node = tree->root;                                            \
+    if (!node) return false;                                                   \
+    while (!node->leaf) {                                                      \
+        uint32_t i = Name##_upper_index(node, key);                            \
+        if (node->children[i]->count <= Name##_min_keys) i = Name##_refill_child(tree, node, i); \
+        Name##_node *child = node->children[i];                                \
+        if (node == tree->root && node->count == 0) {                          \
+            FREE(tree->alloc, node);                                           \
+            tree->root = child;                                                \
+        }                                                                      \
+        node = child;                                                          \
+    }                                                                          \
+    uint32_t i = Name##_lower_index(node, key);                                \
+    if (i >= node->count || cmp(node->keys[i], key) != 0) return false;        \
+    memmove(node->keys + i, node->keys + i + 1, (node->count - i - 1) * sizeof(K)); \
+    memmove(node->values + i, node->values + i + 1, (node->count - i - 1) * sizeof(V)); \
+    node->count--;                                                             \
+    tree->length--;                                                            \
+    if (node == tree->root && node->count == 0) {                              \
+        FREE(tree->alloc, node);                                               \
+        tree->root = NULL;                                                     \
+    }                                                                          \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline Name##_iter Name##_begin(const Name *tree) {                     \
+    Name##_iter it = { tree->root, 0 };                                        \
+    while (it.leaf && !it.leaf->leaf) it.leaf = it.leaf->children[0];          \
+    return it;                                                                 \
+}                                                                              \
+                                                                               \
+/* Iterator at the first key >= key */                                         \
+static inline Name##_iter Name##_lower_bound(const Name *tree, K key) {        \
+    Name##_iter it = { Name##_find_leaf(tree, key), 0 };                       \
+    if (it.leaf) it.index = Name##_lower_index(it.leaf, key);                  \
+    return it;                                                                 \
+}                                                                              \
+                                                                               \
+/* Iterator at the first key > key */                                          \
+static inline Name##_iter Name##_upper_bound(const Name *tree, K key) {        \
+    Name##_iter it = { Name##_find_leaf(tree, key), 0 };                       \
+    if (it.leaf) it.index = Name##_upper_index(it.leaf, key);                  \
+    return it;                                                                 \
+}                                                                              \
+                                                                               \
+/* Iterate in key order with: while (Name##_next(&it, &key, &value)) ...       \
+ * Either out pointer may be NULL. */                                          \
+static inline bool Name##_next(Name##_iter *it, K **key, V **value) {          \
+    while (it->leaf && it->index >= it->leaf->count) {                         \
+        it->leaf = it->leaf->next;                                             \
+        it->index = 0;                                                         \
+    }                                                                          \
+    if (!it->leaf) return false;                                               \
+    if (key) *key = &it->leaf->keys[it->index];                                \
+    if (value) *value = &it->leaf->values[it->index];                          \
+    it->index++;                                                               \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* bulk_load scratch comes from the tree's own allocator. A temp-arena mark    \
+ * would also rewind the nodes when the tree allocates from that arena. */     \
+static inline void Name##_scratch_release(Name *tree, void *level, void *mins) { \
+    if (level) FREE(tree->alloc, level);                                       \
+    if (mins) FREE(tree->alloc, mins);                                         \
+}                                                                              \
+                                                                               \
+/* Replace the contents with count entries whose keys are sorted and unique.   \
+ * Builds full leaves and inner levels bottom-up in O(n), spreading entries    \
+ * evenly so no node ends up below the minimum fill. */                        \
+static inline bool Name##_bulk_load(Name *tree, const K *keys, const V *values, size_t count) { \
+    Name##_free(tree);                                                         \
+    if (count == 0) return true;                                               \
+    size_t n = (count + Name##_max_keys - 1) / Name##_max_keys;                \
+    Name##_node **level = (Name##_node**)ALLOC(tree->alloc, n * sizeof(Name##_node*)); \
+    K *mins = (K*)ALLOC(tree->alloc, n * sizeof(K));                           \
+    if (!level || !mins) {                                                     \
+        Name##_scratch_release(tree, level, mins);                             \
+        return false;                                                          \
+    }                                                                          \
+    size_t done = 0;                                                           \
+    for (size_t j = 0; j < n; j++) {                                           \
+        Name##_node *leaf = Name##_node_new(tree, true);                       \
+        if (!leaf) {                                                           \
+            while (j--) FREE(tree->alloc, level[j]);                           \
+            Name##_scratch_release(tree, level, mins);                         \
+            return false;                                                      \
+        }                                                                      \
+        leaf->count = (uint32_t)((count - done) / (n - j));                    \
+        memcpy(leaf->keys, keys + done, leaf->count * sizeof(K));              \
+        memcpy(leaf->values, values + done, leaf->count * sizeof(V));          \
+        if (j) level[j - 1]->next = leaf;                                      \
+        level[j] = leaf;                                                       \
+        mins[j] = leaf->keys[0];                                               \
+        done += leaf->count;                                                   \
+    }                                                                          \
+    /* Parents overwrite level[] in place; level[0, p) are built parents and   \
+     * level[consumed, n) the children not yet adopted. */                     \
+    while (n > 1) {                                                            \
+        size_t parents = (n + Name##_max_keys) / (Name##_max_keys + 1);        \
+        size_t consumed = 0;                                                   \
+        for (size_t p = 0; p < parents; p++) {                                 \
+            Name##_node *node = Name##_node_new(tree, false);                  \
+            if (!node) {                                                       \
+                for (size_t j = 0; j < p; j++) Name##_free_subtree(tree, level[j]); \
+                for (size_t j = consumed; j < n; j++) Name##_free_subtree(tree, level[j]); \
+                Name##_scratch_release(tree, level, mins);                     \
+                return false;                                                  \
+            }                                                                  \
+            size_t children = (n - consumed) / (parents - p);                  \
+            K first = mins[consumed];                                          \
+            for (size_t c = 0; c < children; c++) {                            \
+                node->children[c] = level[consumed + c];                       \
+                if (c) node->keys[c - 1] = mins[consumed + c];                 \
+            }                                                                  \
+            node->count = (uint32_t)(children - 1);                            \
+            consumed += children;                                              \
+            level[p] = node;                                                   \
+            mins[p] = first;                                                   \
+        }                                                                      \
+        n = parents;                                                           \
+    }                                                                          \
+    tree->root = level[0];                                                     \
+    tree->length = count;                                                      \
+    Name##_scratch_release(tree, level, mins);                                 \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline void Name##_delete(Name *tree) {                                 \
+    if (tree->alloc && tree->alloc->free_all) {                                \
+        FREE_ALL(tree->alloc);                                                 \
+    } else if (tree->root) {                                                   \
+        Name##_free_subtree(tree, tree->root);                                 \
+    }                                                                          \
+    tree->root = NULL;                                                         \
+    tree->length = 0;                                                          \
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -51,6 +51,8 @@
 #include "units.h"      /* Strongly-typed unit conversions        */
 #include "threading.h"  /* Cross platform multi-threading         */
 #include "patch.h"      /* Runtime dynamic library loader         */
+#include "text.h"       /* String builder and string interning    */
+#include "tasks.h"      /* Work-stealing thread pool              */
 
 #else /* LIBDIESEL_MIN_BUILD */
 
@@ -3,11 +3,38 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threading.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* -------------------------------------------------------------------------- */
+/* Alignment                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Alignment every allocator in the library guarantees by default.
+ *
+ * Matches what malloc returns on the supported platforms.
+ */
+#ifndef MEM_DEFAULT_ALIGNMENT
+#define MEM_DEFAULT_ALIGNMENT (sizeof(void*) * 2)
+#endif
+
+/**
+ * @brief Assumed cache line size, for use with ALLOC_ALIGNED.
+ */
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/**
+ * @brief Round a size or address up to a power-of-two alignment.
+ */
+#define ALIGN_UP(x, align) (((x) + ((align) - 1)) & ~((uintptr_t)(align) - 1))
+
 /* -------------------------------------------------------------------------- */
 /* Arena types                                                                 */
 /* -------------------------------------------------------------------------- */
@@ -22,16 +49,143 @@ typedef struct _arena_block {
     struct _arena_block* next; /**< Next block in the arena */
 } _arena_block;
 
+/**
+ * @brief Largest block the arena will grow to on its own.
+ *
+ * Block sizes double each time the arena runs out of room, up to this cap.
+ * Allocations larger than the cap still get a block sized to fit them.
+ */
+#ifndef ARENA_MAX_BLOCK_SIZE
+#define ARENA_MAX_BLOCK_SIZE ((size_t)64 * 1024 * 1024)
+#endif
+
 /**
  * @brief Arena allocator structure.
  *
  * Manages a linked list of memory blocks for fast allocation and reset.
+ * Allocation bumps a pointer in current_block; blocks after it in the list
+ * are free and get reused before any new block is created.
  */
 typedef struct {
-    _arena_block* root_block; /**< First block in the arena */
-    size_t block_size;        /**< Default block size for new allocations */
+    _arena_block* root_block;    /**< First block in the arena */
+    _arena_block* current_block; /**< Block new allocations are bumped from */
+    size_t block_size;           /**< Default block size for new allocations */
+    size_t next_block_size;      /**< Size of the next block to create (grows geometrically) */
 } arena_t;
 
+/**
+ * @brief Saved arena position, see arena_mark and arena_rewind_to.
+ */
+typedef struct {
+    _arena_block* block; /**< Block that was current when the mark was taken */
+    size_t used;         /**< Bytes used in that block at the time */
+} arena_mark_t;
+
+/* -------------------------------------------------------------------------- */
+/* Virtual memory arena types                                                  */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Page backing options for vm_arena_init.
+ */
+typedef enum {
+    VM_ARENA_DEFAULT = 0,         /**< Regular pages */
+    VM_ARENA_TRANSPARENT_HUGE = 1,/**< Ask the kernel for transparent huge pages (Linux) */
+    VM_ARENA_HUGE_PAGES = 2       /**< Explicit huge pages for the whole reservation, falling back to transparent ones */
+} vm_arena_flags_t;
+
+/**
+ * @brief Contiguous arena backed by one reserved virtual address range.
+ *
+ * The whole range is reserved up front and pages are committed as used
+ * grows, so pointers never move and no block chaining is needed.
+ */
+typedef struct {
+    char* base;          /**< Start of the reserved range */
+    size_t reserved;     /**< Bytes reserved */
+    size_t committed;    /**< Bytes committed, from base */
+    size_t used;         /**< Bytes handed out, from base */
+    size_t granularity;  /**< Commit granularity (page or huge page size) */
+    int flags;           /**< vm_arena_flags_t the arena was created with */
+} vm_arena_t;
+
+/* -------------------------------------------------------------------------- */
+/* Pool types                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief A chunk of backing storage for a pool, followed by its objects.
+ */
+typedef struct _pool_chunk {
+    struct _pool_chunk* next; /**< Next chunk in the pool */
+} _pool_chunk;
+
+/**
+ * @brief Header written over a released pool object.
+ */
+typedef struct _pool_slot {
+    struct _pool_slot* next; /**< Next free object */
+} _pool_slot;
+
+/**
+ * @brief Fixed-size object pool.
+ *
+ * Hands out objects of one size from chunks of objects_per_chunk objects.
+ * Released objects go on a free list and are reused first; untouched objects
+ * are carved from the current chunk on demand, so alloc and free are O(1).
+ */
+typedef struct {
+    _pool_chunk* root_chunk;    /**< First chunk in the pool */
+    _pool_chunk* current_chunk; /**< Chunk fresh objects are carved from */
+    _pool_slot* free_list;      /**< Released objects ready for reuse */
+    char* next_object;          /**< Next never-used object in current_chunk */
+    char* chunk_end;            /**< End of current_chunk's objects */
+    size_t object_size;         /**< Size of each object, rounded up to MEM_DEFAULT_ALIGNMENT */
+    size_t objects_per_chunk;   /**< Number of objects per chunk */
+} pool_t;
+
+/**
+ * @brief Per-thread cache of a concurrent pool.
+ *
+ * Only the owning thread touches local_free and the carving cursor; other
+ * threads hand objects back through the lock-free remote_free stack.
+ */
+typedef struct _cpool_heap {
+    struct _cpool_heap* next;     /**< Next heap in the pool (immutable once published) */
+    struct _cpool_chunk* chunks;  /**< Chunks owned by this heap */
+    _pool_slot* local_free;       /**< Objects freed by the owning thread */
+    atomicptr_t remote_free;      /**< _pool_slot stack of objects freed by other threads */
+    char* next_object;            /**< Next never-used object in the newest chunk */
+    char* chunk_end;              /**< End of the newest chunk's objects */
+    atomic32_t owned;             /**< 1 while a live thread owns this heap */
+} _cpool_heap;
+
+/**
+ * @brief Chunk header of a concurrent pool.
+ *
+ * Chunks are aligned to their own size so any object can find its chunk,
+ * and through it its owning heap, by masking its address.
+ */
+typedef struct _cpool_chunk {
+    struct _cpool_chunk* next; /**< Next chunk of the same heap */
+    _cpool_heap* heap;         /**< Heap that owns this chunk's objects */
+} _cpool_chunk;
+
+/**
+ * @brief Thread-safe fixed-size object pool.
+ *
+ * Every thread allocates from its own heap without synchronization. Objects
+ * freed on another thread are pushed back to their owner's heap through a
+ * lock-free stack, which the owner drains in one atomic exchange when its
+ * local free list runs dry. Heaps of exited threads are adopted by new ones.
+ */
+typedef struct {
+    atomicptr_t heaps;       /**< _cpool_heap list of all heaps created for this pool */
+    size_t object_size;      /**< Size of each object, rounded up to MEM_DEFAULT_ALIGNMENT */
+    size_t chunk_size;       /**< Size and alignment of each chunk */
+    tls_key_t heap_key;      /**< Maps each thread to its heap */
+} concurrent_pool_t;
+
 /* -------------------------------------------------------------------------- */
 /* Allocator type                                                              */
 /* -------------------------------------------------------------------------- */
@@ -71,6 +225,16 @@ typedef void  (*free_all_fn)(void* ctx);
  */
 typedef void* (*realloc_fn)(void* ctx, void* ptr, size_t old_size, size_t new_size);
 
+/**
+ * @brief Function pointer type for aligned allocation.
+ *
+ * @param ctx User-defined context
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes (power of two)
+ * @return Pointer to allocated memory, releasable with the allocator's free
+ */
+typedef void* (*alloc_aligned_fn)(void* ctx, size_t size, size_t alignment);
+
 /**
  * @brief Generic allocator structure.
  */
@@ -80,16 +244,125 @@ typedef struct {
     free_all_fn free_all; /**< Optional bulk-free function */
     realloc_fn realloc;   /**< Optional realloc function */
     void* ctx;            /**< User-defined context passed to functions */
+    alloc_aligned_fn alloc_aligned; /**< Optional aligned allocation function */
 } allocator_t;
 
+/* -------------------------------------------------------------------------- */
+/* Tracking allocator types                                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Number of power-of-two size classes in allocation histograms.
+ *
+ * Class 0 counts allocations of up to 16 bytes, class i up to 16 << i
+ * bytes, and the last class everything larger.
+ */
+#define TRACKING_SIZE_CLASSES 16
+
+/**
+ * @brief Aggregated statistics of a tracking allocator.
+ */
+typedef struct {
+    size_t live_bytes;        /**< Bytes currently allocated */
+    size_t peak_bytes;        /**< Highest observed live_bytes, sampled whenever a thread folds its counters */
+    uint64_t alloc_count;     /**< Number of allocations */
+    uint64_t free_count;      /**< Number of frees */
+    uint64_t realloc_count;   /**< Number of reallocations */
+    uint64_t size_histogram[TRACKING_SIZE_CLASSES]; /**< Allocations per size class */
+} allocator_stats_t;
+
+/**
+ * @brief Per-call-site statistics, recorded with DIESEL_TRACK_CALLSITES.
+ */
+typedef struct {
+    const char* file;         /**< Source file of the allocation */
+    int line;                 /**< Source line of the allocation */
+    size_t live_bytes;        /**< Bytes from this site still allocated */
+    uint64_t alloc_count;     /**< Number of allocations from this site */
+} tracking_callsite_t;
+
+/**
+ * @brief Call sites a tracking allocator can tell apart.
+ *
+ * Sites beyond this are still counted in the totals, just not per site.
+ */
+#define TRACKING_MAX_CALLSITES 1024
+
+/**
+ * @brief One slot of a tracking allocator's call-site table.
+ *
+ * The table is a fixed open-addressing hash keyed by file pointer and line,
+ * so lookups and counter updates never take a lock. A slot is claimed by
+ * moving state from 0 to 1 and published by storing 2 once file and line
+ * are written.
+ */
+typedef struct {
+    atomic32_t state;         /**< 0 empty, 1 being claimed, 2 published */
+    int line;                 /**< Source line of the allocation */
+    const char* file;         /**< Source file of the allocation */
+    atomic64_t live_bytes;    /**< Bytes from this site still allocated */
+    atomic64_t alloc_count;   /**< Number of allocations from this site */
+} _tracking_site;
+
+/**
+ * @brief One thread's counters in a tracking allocator.
+ *
+ * Only the owning thread writes them, so updates need no atomic
+ * read-modify-write. live_delta is folded into the shared total once it
+ * grows past a threshold, which is also when the peak is updated. When the
+ * thread exits its node is handed to the next new thread, so the list only
+ * grows with the number of threads alive at once.
+ */
+typedef struct _tracking_thread_stats {
+    struct _tracking_thread_stats* next; /**< Next thread in the allocator */
+    void* tracker;                       /**< tracking_allocator_t the node belongs to */
+    atomic32_t owned;                    /**< 0 once the thread exited; adoptable */
+    atomic64_t live_delta;               /**< Live bytes not yet folded into the total */
+    atomic64_t alloc_count;              /**< Allocations made by this thread */
+    atomic64_t free_count;               /**< Frees made by this thread */
+    atomic64_t realloc_count;            /**< Reallocations made by this thread */
+    atomic64_t size_histogram[TRACKING_SIZE_CLASSES]; /**< Allocations per size class */
+} _tracking_thread_stats;
+
+/**
+ * @brief Allocator wrapper that records usage statistics.
+ *
+ * Forwards to a backing allocator, prefixing every allocation with a small
+ * header that remembers its size and call site.
+ */
+typedef struct {
+    allocator_t* backing;             /**< Allocator that provides the memory */
+    atomicptr_t threads;              /**< _tracking_thread_stats list of every thread */
+    tls_key_t stats_key;              /**< Maps each thread to its counters */
+    atomic64_t live_bytes;            /**< Folded live bytes */
+    atomicsz_t peak_bytes;            /**< Peak of live_bytes */
+    _tracking_site* sites;            /**< TRACKING_MAX_CALLSITES call-site slots */
+    atomicsz_t site_count;            /**< Slots claimed in sites */
+} tracking_allocator_t;
+
 /* -------------------------------------------------------------------------- */
 /* Helper macros                                                              */
 /* -------------------------------------------------------------------------- */
 
+/**
+ * @brief Hook that records the calling file and line before an allocation.
+ *
+ * Define DIESEL_TRACK_CALLSITES before including this header to have
+ * ALLOC, REALLOC and their aligned forms report their call site to a
+ * tracking allocator. Expands to nothing otherwise.
+ */
+#ifdef DIESEL_TRACK_CALLSITES
+    #define _ALLOC_CALLSITE() _alloc_note_callsite(__FILE__, __LINE__),
+    #define _ALLOC_CALLSITE_END(ptr) _alloc_clear_callsite(ptr)
+#else
+    #define _ALLOC_CALLSITE()
+    #define _ALLOC_CALLSITE_END(ptr) (ptr)
+#endif
+
 /**
  * @brief Allocate memory using an allocator.
  */
-#define ALLOC(a, size) ((a)->alloc((a)->ctx, (size)))
+#define ALLOC(a, size) _ALLOC_CALLSITE_END((_ALLOC_CALLSITE() (a)->alloc((a)->ctx, (size))))
 
 /**
  * @brief Free memory using an allocator.
@@ -105,7 +378,44 @@ typedef struct {
  * @brief Reallocate memory using an allocator, or fallback to default.
  */
 #define REALLOC(a, ptr, old_size, new_size) \
-    ((a)->realloc ? (a)->realloc((a)->ctx, (ptr), (old_size), (new_size)) : _default_realloc((a), (ptr), (old_size), (new_size)))
+    _ALLOC_CALLSITE_END((_ALLOC_CALLSITE() (a)->realloc ? (a)->realloc((a)->ctx, (ptr), (old_size), (new_size)) : _default_realloc((a), (ptr), (old_size), (new_size))))
+
+/**
+ * @brief Allocate memory with a given power-of-two alignment.
+ *
+ * Allocators without an alloc_aligned function can only satisfy alignments
+ * up to MEM_DEFAULT_ALIGNMENT; larger requests fail with NULL unless the
+ * returned block happens to be aligned. Use ALLOC_PREFER_ALIGNED when the
+ * alignment only helps performance. Release the memory with FREE as usual.
+ */
+#define ALLOC_ALIGNED(a, size, alignment) \
+    _ALLOC_CALLSITE_END((_ALLOC_CALLSITE() (a)->alloc_aligned ? (a)->alloc_aligned((a)->ctx, (size), (alignment)) : _default_alloc_aligned((a), (size), (alignment))))
+
+/**
+ * @brief Reallocate memory while keeping a power-of-two alignment.
+ *
+ * Memory obtained with ALLOC_ALIGNED must be resized with this macro rather
+ * than REALLOC, which only preserves MEM_DEFAULT_ALIGNMENT.
+ */
+#define REALLOC_ALIGNED(a, ptr, old_size, new_size, alignment) \
+    _ALLOC_CALLSITE_END((_ALLOC_CALLSITE() _default_realloc_aligned((a), (ptr), (old_size), (new_size), (alignment))))
+
+/**
+ * @brief Allocate memory aligned to alignment if the allocator can, otherwise
+ *        with its default alignment.
+ *
+ * For callers that align only for performance (cache lines, SIMD-friendly
+ * columns): an allocator without alloc_aligned yields plain ALLOC memory
+ * instead of a failure. Release the memory with FREE as usual.
+ */
+#define ALLOC_PREFER_ALIGNED(a, size, alignment) \
+    _ALLOC_CALLSITE_END((_ALLOC_CALLSITE() _alloc_prefer_aligned((a), (size), (alignment))))
+
+/**
+ * @brief Reallocate memory obtained with ALLOC_PREFER_ALIGNED.
+ */
+#define REALLOC_PREFER_ALIGNED(a, ptr, old_size, new_size, alignment) \
+    _ALLOC_CALLSITE_END((_ALLOC_CALLSITE() _realloc_prefer_aligned((a), (ptr), (old_size), (new_size), (alignment))))
 
 /**
  * @brief Default realloc fallback if allocator does not provide one.
@@ -118,6 +428,71 @@ typedef struct {
  */
 void* _default_realloc(allocator_t* a, void* ptr, size_t old_size, size_t new_size);
 
+/**
+ * @brief Aligned allocation fallback if allocator does not provide one.
+ *
+ * @param a Allocator
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes
+ * @return Pointer to allocated memory, or NULL if the alignment cannot be met
+ */
+void* _default_alloc_aligned(allocator_t* a, size_t size, size_t alignment);
+
+/**
+ * @brief Aligned realloc used by REALLOC_ALIGNED.
+ *
+ * @param a Allocator
+ * @param ptr Existing memory pointer
+ * @param old_size Old memory size
+ * @param new_size New memory size
+ * @param alignment Required alignment in bytes
+ * @return Pointer to resized memory
+ */
+void* _default_realloc_aligned(allocator_t* a, void* ptr, size_t old_size, size_t new_size, size_t alignment);
+
+/**
+ * @brief Allocation used by ALLOC_PREFER_ALIGNED.
+ *
+ * @param a Allocator
+ * @param size Number of bytes to allocate
+ * @param alignment Preferred alignment in bytes
+ * @return Pointer to allocated memory, or NULL if out of memory
+ */
+void* _alloc_prefer_aligned(allocator_t* a, size_t size, size_t alignment);
+
+/**
+ * @brief Reallocation used by REALLOC_PREFER_ALIGNED.
+ *
+ * @param a Allocator
+ * @param ptr Existing memory pointer
+ * @param old_size Old memory size
+ * @param new_size New memory size
+ * @param alignment Preferred alignment in bytes
+ * @return Pointer to resized memory
+ */
+void* _realloc_prefer_aligned(allocator_t* a, void* ptr, size_t old_size, size_t new_size, size_t alignment);
+
+/**
+ * @brief Record the call site of the next allocation on this thread.
+ *
+ * Called by the allocation macros when DIESEL_TRACK_CALLSITES is defined.
+ *
+ * @param file Source file of the call (a string literal)
+ * @param line Source line of the call
+ */
+void _alloc_note_callsite(const char* file, int line);
+
+/**
+ * @brief Forget the call site noted for this thread's allocation.
+ *
+ * Called by the allocation macros once the allocation returns, so a note
+ * that no tracking allocator consumed cannot leak into a later allocation.
+ *
+ * @param ptr Result of the allocation
+ * @return ptr
+ */
+void* _alloc_clear_callsite(void* ptr);
+
 /* -------------------------------------------------------------------------- */
 /* Arena API                                                                  */
 /* -------------------------------------------------------------------------- */
@@ -126,7 +501,7 @@ void* _default_realloc(allocator_t* a, void* ptr, size_t old_size, size_t new_si
  * @brief Initialize an arena.
  *
  * @param arena Pointer to arena to initialize
- * @param block_size Default block size for allocations
+ * @param block_size Size of the first block; later blocks double in size
  */
 void arena_init(arena_t* arena, size_t block_size);
 
@@ -144,15 +519,56 @@ void arena_destroy(arena_t* arena);
  */
 void arena_reset(arena_t* arena);
 
+/**
+ * @brief Record the current position of an arena.
+ *
+ * @param arena Arena to mark
+ * @return Mark to pass to arena_rewind_to
+ */
+arena_mark_t arena_mark(arena_t* arena);
+
+/**
+ * @brief Release everything allocated from an arena since a mark, in O(1).
+ *
+ * Marks must be rewound in LIFO order; rewinding to a mark invalidates every
+ * mark taken after it.
+ *
+ * @param arena Arena to rewind
+ * @param mark Mark previously returned by arena_mark on this arena
+ */
+void arena_rewind_to(arena_t* arena, arena_mark_t mark);
+
 /**
  * @brief Allocate memory from an arena.
  *
+ * The returned pointer is aligned to MEM_DEFAULT_ALIGNMENT.
+ *
  * @param arena Arena to allocate from
  * @param size Number of bytes to allocate
  * @return Pointer to allocated memory
  */
 void* arena_malloc(arena_t* arena, size_t size);
 
+/**
+ * @brief Allocate aligned memory from an arena.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes (power of two)
+ * @return Pointer to allocated memory
+ */
+void* arena_malloc_aligned(arena_t* arena, size_t size, size_t alignment);
+
+/**
+ * @brief Aligned allocation from an arena (used as an alloc_aligned_fn).
+ *
+ * @param ctx Pointer to arena_t
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes
+ * @return Pointer to allocated memory
+ */
+void* arena_alloc_aligned(void* ctx, size_t size, size_t alignment);
+
 /**
  * @brief Free all memory allocated from an arena (used as a free_all_fn).
  *
@@ -163,6 +579,9 @@ void arena_free_all_fn(void* ctx);
 /**
  * @brief Reallocate memory in an arena.
  *
+ * If ptr is the arena's most recent allocation it grows or shrinks in place
+ * whenever the current block has room; otherwise the data is copied.
+ *
  * @param ctx Pointer to arena_t
  * @param ptr Existing memory pointer
  * @param old_size Original size of memory
@@ -171,6 +590,418 @@ void arena_free_all_fn(void* ctx);
  */
 void* arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
 
+/**
+ * @brief Allocate memory from an arena (used as an alloc_fn).
+ *
+ * @param ctx Pointer to arena_t
+ * @param size Number of bytes to allocate
+ * @return Pointer to allocated memory
+ */
+void* arena_alloc(void* ctx, size_t size);
+
+/**
+ * @brief Free a single arena allocation (used as a free_fn). Does nothing.
+ *
+ * @param ctx Pointer to arena_t
+ * @param ptr Pointer to memory
+ */
+void arena_free(void* ctx, void* ptr);
+
+/**
+ * @brief Build an allocator that allocates from an arena.
+ *
+ * @param arena Arena to allocate from; must outlive the allocator
+ * @return Allocator using the arena_* functions
+ */
+allocator_t arena_allocator(arena_t* arena);
+
+/* -------------------------------------------------------------------------- */
+/* Virtual memory arena API                                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Reserve address space for a virtual memory arena.
+ *
+ * No physical memory is used until allocations reach it.
+ *
+ * @param arena Pointer to arena to initialize
+ * @param reserve_size Maximum size the arena can grow to
+ * @param flags Combination of vm_arena_flags_t
+ * @return true on success, false if the range could not be reserved
+ */
+bool vm_arena_init(vm_arena_t* arena, size_t reserve_size, int flags);
+
+/**
+ * @brief Release a virtual memory arena's whole address range.
+ *
+ * @param arena Pointer to arena to destroy
+ */
+void vm_arena_destroy(vm_arena_t* arena);
+
+/**
+ * @brief Reset a virtual memory arena and return its pages to the OS.
+ *
+ * The range stays reserved; pages are zero-filled again on next use.
+ *
+ * @param arena Pointer to arena to reset
+ */
+void vm_arena_reset(vm_arena_t* arena);
+
+/**
+ * @brief Allocate memory from a virtual memory arena.
+ *
+ * The returned pointer is aligned to MEM_DEFAULT_ALIGNMENT.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes to allocate
+ * @return Pointer to allocated memory, or NULL once the reservation is full
+ */
+void* vm_arena_malloc(vm_arena_t* arena, size_t size);
+
+/**
+ * @brief Allocate aligned memory from a virtual memory arena.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes (power of two)
+ * @return Pointer to allocated memory
+ */
+void* vm_arena_malloc_aligned(vm_arena_t* arena, size_t size, size_t alignment);
+
+/**
+ * @brief Record the current position of a virtual memory arena.
+ *
+ * @param arena Arena to mark
+ * @return Mark to pass to vm_arena_rewind_to
+ */
+size_t vm_arena_mark(vm_arena_t* arena);
+
+/**
+ * @brief Release everything allocated since a mark. Pages stay committed.
+ *
+ * @param arena Arena to rewind
+ * @param mark Mark previously returned by vm_arena_mark
+ */
+void vm_arena_rewind_to(vm_arena_t* arena, size_t mark);
+
+/**
+ * @brief Allocate from a virtual memory arena (used as an alloc_fn).
+ *
+ * @param ctx Pointer to vm_arena_t
+ * @param size Number of bytes to allocate
+ * @return Pointer to allocated memory
+ */
+void* vm_arena_alloc(void* ctx, size_t size);
+
+/**
+ * @brief Aligned allocation from a virtual memory arena (used as an alloc_aligned_fn).
+ *
+ * @param ctx Pointer to vm_arena_t
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes
+ * @return Pointer to allocated memory
+ */
+void* vm_arena_alloc_aligned(void* ctx, size_t size, size_t alignment);
+
+/**
+ * @brief Reset a virtual memory arena (used as a free_all_fn).
+ *
+ * @param ctx Pointer to vm_arena_t
+ */
+void vm_arena_free_all_fn(void* ctx);
+
+/**
+ * @brief Reallocate memory in a virtual memory arena (used as a realloc_fn).
+ *
+ * The most recent allocation grows or shrinks in place.
+ *
+ * @param ctx Pointer to vm_arena_t
+ * @param ptr Existing memory pointer
+ * @param old_size Original size of memory
+ * @param new_size New requested size
+ * @return Pointer to resized memory
+ */
+void* vm_arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Build an allocator that allocates from a virtual memory arena.
+ *
+ * @param arena Arena to allocate from; must outlive the allocator
+ * @return Allocator using the vm_arena_* functions
+ */
+allocator_t vm_arena_allocator(vm_arena_t* arena);
+
+/* -------------------------------------------------------------------------- */
+/* Pool API                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize a pool.
+ *
+ * @param pool Pointer to pool to initialize
+ * @param object_size Size of each object in bytes
+ * @param objects_per_chunk Objects per backing chunk (0 for a default of 64)
+ */
+void pool_init(pool_t* pool, size_t object_size, size_t objects_per_chunk);
+
+/**
+ * @brief Destroy a pool and free all of its chunks.
+ *
+ * @param pool Pointer to pool to destroy
+ */
+void pool_destroy(pool_t* pool);
+
+/**
+ * @brief Release every object in a pool at once, keeping its chunks.
+ *
+ * @param pool Pointer to pool to reset
+ */
+void pool_reset(pool_t* pool);
+
+/**
+ * @brief Allocate one object from a pool.
+ *
+ * @param pool Pool to allocate from
+ * @return Pointer to an object of pool->object_size bytes
+ */
+void* pool_malloc(pool_t* pool);
+
+/**
+ * @brief Return an object to its pool.
+ *
+ * @param pool Pool the object came from
+ * @param ptr Object to release (NULL is ignored)
+ */
+void pool_release(pool_t* pool, void* ptr);
+
+/**
+ * @brief Allocate from a pool (used as an alloc_fn).
+ *
+ * @param ctx Pointer to pool_t
+ * @param size Requested size; NULL is returned if it exceeds the object size
+ * @return Pointer to allocated memory
+ */
+void* pool_alloc(void* ctx, size_t size);
+
+/**
+ * @brief Return an object to a pool (used as a free_fn).
+ *
+ * @param ctx Pointer to pool_t
+ * @param ptr Pointer to memory to free
+ */
+void pool_free(void* ctx, void* ptr);
+
+/**
+ * @brief Release every object in a pool (used as a free_all_fn).
+ *
+ * @param ctx Pointer to pool_t
+ */
+void pool_free_all_fn(void* ctx);
+
+/**
+ * @brief Reallocate within a pool (used as a realloc_fn).
+ *
+ * Succeeds in place while new_size fits in one object and fails otherwise.
+ *
+ * @param ctx Pointer to pool_t
+ * @param ptr Existing memory pointer
+ * @param old_size Original size of memory
+ * @param new_size New requested size
+ * @return Pointer to resized memory
+ */
+void* pool_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Build an allocator that allocates from a pool.
+ *
+ * Pass it to SL_LIST_DEFINE lists with a pool of sizeof(Name##_node) objects
+ * so appends and pops never reach the general-purpose heap.
+ *
+ * @param pool Pool to allocate from; must outlive the allocator
+ * @return Allocator using the pool_* functions
+ */
+allocator_t pool_allocator(pool_t* pool);
+
+/* -------------------------------------------------------------------------- */
+/* Concurrent pool API                                                        */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize a concurrent pool.
+ *
+ * @param pool Pointer to pool to initialize
+ * @param object_size Size of each object in bytes
+ * @return true on success, false if no thread-local key was available
+ */
+bool concurrent_pool_init(concurrent_pool_t* pool, size_t object_size);
+
+/**
+ * @brief Destroy a concurrent pool and free all of its memory.
+ *
+ * No other thread may use the pool during or after this call.
+ *
+ * @param pool Pointer to pool to destroy
+ */
+void concurrent_pool_destroy(concurrent_pool_t* pool);
+
+/**
+ * @brief Allocate one object from the calling thread's heap.
+ *
+ * @param pool Pool to allocate from
+ * @return Pointer to an object of pool->object_size bytes
+ */
+void* concurrent_pool_malloc(concurrent_pool_t* pool);
+
+/**
+ * @brief Return an object to its pool from any thread.
+ *
+ * @param pool Pool the object came from
+ * @param ptr Object to release (NULL is ignored)
+ */
+void concurrent_pool_release(concurrent_pool_t* pool, void* ptr);
+
+/**
+ * @brief Allocate from a concurrent pool (used as an alloc_fn).
+ *
+ * @param ctx Pointer to concurrent_pool_t
+ * @param size Requested size; NULL is returned if it exceeds the object size
+ * @return Pointer to allocated memory
+ */
+void* concurrent_pool_alloc(void* ctx, size_t size);
+
+/**
+ * @brief Return an object to a concurrent pool (used as a free_fn).
+ *
+ * @param ctx Pointer to concurrent_pool_t
+ * @param ptr Pointer to memory to free
+ */
+void concurrent_pool_free(void* ctx, void* ptr);
+
+/**
+ * @brief Reallocate within a concurrent pool (used as a realloc_fn).
+ *
+ * Succeeds in place while new_size fits in one object and fails otherwise.
+ *
+ * @param ctx Pointer to concurrent_pool_t
+ * @param ptr Existing memory pointer
+ * @param old_size Original size of memory
+ * @param new_size New requested size
+ * @return Pointer to resized memory
+ */
+void* concurrent_pool_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Build an allocator that allocates from a concurrent pool.
+ *
+ * The allocator can be shared by any number of threads. It has no
+ * free_all, since other threads may still hold objects.
+ *
+ * @param pool Pool to allocate from; must outlive the allocator
+ * @return Allocator using the concurrent_pool_* functions
+ */
+allocator_t concurrent_pool_allocator(concurrent_pool_t* pool);
+
+/* -------------------------------------------------------------------------- */
+/* Tracking allocator API                                                     */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize a tracking allocator.
+ *
+ * @param tracker Tracker to initialize
+ * @param backing Allocator to forward to (NULL for default_allocator)
+ * @return true on success, false if no thread-local key or memory for the
+ *         call-site table was available
+ */
+bool tracking_allocator_init(tracking_allocator_t* tracker, allocator_t* backing);
+
+/**
+ * @brief Destroy a tracking allocator's bookkeeping.
+ *
+ * Memory still allocated through it is not freed.
+ *
+ * @param tracker Tracker to destroy
+ */
+void tracking_allocator_destroy(tracking_allocator_t* tracker);
+
+/**
+ * @brief Build an allocator that records into a tracker.
+ *
+ * @param tracker Tracker to record into; must outlive the allocator
+ * @return Allocator using the tracking_* functions
+ */
+allocator_t tracking_allocator(tracking_allocator_t* tracker);
+
+/**
+ * @brief Aggregate every thread's counters.
+ *
+ * @param tracker Tracker to read
+ * @param out Receives the totals
+ */
+void tracking_allocator_stats(tracking_allocator_t* tracker, allocator_stats_t* out);
+
+/**
+ * @brief Copy out the per-call-site statistics.
+ *
+ * Only allocations made through the macros with DIESEL_TRACK_CALLSITES
+ * defined are attributed to a call site. Sites are keyed by the __FILE__
+ * pointer, so an inline function in a header can show up once per
+ * translation unit that uses it. Entries come out in table order.
+ *
+ * @param tracker Tracker to read
+ * @param out Array receiving up to max entries (may be NULL)
+ * @param max Capacity of out
+ * @return Total number of call sites recorded
+ */
+size_t tracking_allocator_callsites(tracking_allocator_t* tracker, tracking_callsite_t* out, size_t max);
+
+/**
+ * @brief Allocate through a tracker (used as an alloc_fn).
+ *
+ * @param ctx Pointer to tracking_allocator_t
+ * @param size Number of bytes to allocate
+ * @return Pointer to allocated memory
+ */
+void* tracking_alloc(void* ctx, size_t size);
+
+/**
+ * @brief Free through a tracker (used as a free_fn).
+ *
+ * @param ctx Pointer to tracking_allocator_t
+ * @param ptr Pointer to memory to free
+ */
+void tracking_free(void* ctx, void* ptr);
+
+/**
+ * @brief Free everything through a tracker (used as a free_all_fn).
+ *
+ * Forwards to the backing allocator's free_all and zeroes the live counts.
+ *
+ * @param ctx Pointer to tracking_allocator_t
+ */
+void tracking_free_all(void* ctx);
+
+/**
+ * @brief Reallocate through a tracker (used as a realloc_fn).
+ *
+ * @param ctx Pointer to tracking_allocator_t
+ * @param ptr Existing memory pointer
+ * @param old_size Original size of memory
+ * @param new_size New requested size
+ * @return Pointer to resized memory
+ */
+void* tracking_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Aligned allocation through a tracker (used as an alloc_aligned_fn).
+ *
+ * @param ctx Pointer to tracking_allocator_t
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes
+ * @return Pointer to allocated memory
+ */
+void* tracking_alloc_aligned(void* ctx, size_t size, size_t alignment);
+
 /* -------------------------------------------------------------------------- */
 /* Default allocator functions                                                */
 /* -------------------------------------------------------------------------- */
@@ -203,6 +1034,81 @@ void malloc_free(void* ctx, void* ptr);
  */
 void* malloc_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
 
+/**
+ * @brief Allocate aligned memory from the C heap.
+ *
+ * Uses posix_memalign, or _aligned_malloc on Windows.
+ *
+ * @param ctx Ignored
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes (power of two)
+ * @return Pointer to allocated memory
+ */
+void* malloc_alloc_aligned(void* ctx, size_t size, size_t alignment);
+
+/* -------------------------------------------------------------------------- */
+/* Size-class allocator functions                                             */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Largest request served from size classes; bigger ones use malloc.
+ */
+#define SIZECLASS_MAX_SIZE 4096
+
+/**
+ * @brief Allocate from the size-class allocator.
+ *
+ * Small requests are rounded up to one of a fixed set of size classes and
+ * served from per-thread free lists, refilled in batches from 64 KiB spans
+ * carved out of one reserved address range. Switch the whole library over
+ * with:
+ *
+ *     set_allocator(&default_allocator, sizeclass_alloc, sizeclass_free,
+ *                   NULL, sizeclass_realloc, NULL);
+ *     set_allocator_aligned(&default_allocator, sizeclass_alloc_aligned);
+ *
+ * Memory obtained from malloc before the switch can still be released
+ * through it, but not the other way around. The address range is reserved
+ * on the first allocation. bench/sizeclass_bench.c compares it with the
+ * system malloc; run it on the target machine before switching.
+ *
+ * @param ctx Ignored
+ * @param size Number of bytes to allocate
+ * @return Pointer to allocated memory
+ */
+void* sizeclass_alloc(void* ctx, size_t size);
+
+/**
+ * @brief Free memory from the size-class allocator, from any thread.
+ *
+ * @param ctx Ignored
+ * @param ptr Pointer to memory to free
+ */
+void sizeclass_free(void* ctx, void* ptr);
+
+/**
+ * @brief Reallocate memory from the size-class allocator.
+ *
+ * Uses old_size to return ptr unchanged when both sizes share a size class.
+ *
+ * @param ctx Ignored
+ * @param ptr Pointer to existing memory
+ * @param old_size Original size of memory
+ * @param new_size New requested size
+ * @return Pointer to resized memory
+ */
+void* sizeclass_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Aligned allocation from the size-class allocator.
+ *
+ * @param ctx Ignored
+ * @param size Number of bytes to allocate
+ * @param alignment Required alignment in bytes (power of two)
+ * @return Pointer to allocated memory
+ */
+void* sizeclass_alloc_aligned(void* ctx, size_t size, size_t alignment);
+
 /* -------------------------------------------------------------------------- */
 /* Global allocators                                                          */
 /* -------------------------------------------------------------------------- */
@@ -214,9 +1120,22 @@ extern allocator_t default_allocator;
 
 /**
  * @brief Temporary allocator for short-lived allocations.
+ *
+ * Allocates from the calling thread's temp_arena(), so threads never share
+ * or contend on it. FREE_ALL resets only the calling thread's arena.
  */
 extern allocator_t default_temp_allocator;
 
+/**
+ * @brief Get the calling thread's temporary arena.
+ *
+ * Created on first use and destroyed when the thread exits. Use it with
+ * arena_mark/arena_rewind_to to scope temporary allocations.
+ *
+ * @return The calling thread's arena, or NULL if it could not be created
+ */
+arena_t* temp_arena(void);
+
 /* -------------------------------------------------------------------------- */
 /* Allocator control                                                          */
 /* -------------------------------------------------------------------------- */
@@ -224,6 +1143,8 @@ extern allocator_t default_temp_allocator;
 /**
  * @brief Configure an allocator with custom functions.
  *
+ * Clears alloc_aligned; use set_allocator_aligned to provide one.
+ *
  * @param target Allocator to configure
  * @param alloc Allocation function
  * @param free Free function
@@ -238,6 +1159,14 @@ void set_allocator(allocator_t* target,
                    realloc_fn realloc,
                    void* ctx);
 
+/**
+ * @brief Set the aligned allocation function of an allocator.
+ *
+ * @param target Allocator to configure
+ * @param alloc_aligned Aligned allocation function, or NULL for the fallback
+ */
+void set_allocator_aligned(allocator_t* target, alloc_aligned_fn alloc_aligned);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include "platform.h"
+#include "memory.h"
 #include "_export.h"
 
 #ifdef __cplusplus
@@ -23,7 +24,7 @@ typedef struct {
 #else
     void *handle;        /**< Handle to the loaded shared library (Unix) */
 #endif
-    char **symbols;      /**< Array of symbol names requested */
+    char **symbols;      /**< Array of symbol names requested, copied into one block */
     void **funcs;        /**< Array of function pointers corresponding to symbols */
     size_t count;        /**< Number of symbols/functions */
 } Patch;
@@ -0,0 +1,272 @@
+#ifndef LIB_DIESEL_TASKS_H
+#define LIB_DIESEL_TASKS_H
+
+#include "types.h"
+#include "memory.h"
+#include "threading.h"
+#include "_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -------------------------------------------------------------------------- */
+/*                          Work-stealing thread pool                         */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief A queued unit of work. Allocated from the pool's concurrent_pool_t.
+ */
+typedef struct _task_node {
+    void (*func)(void*);
+    void* arg;
+    struct _task_node* next;    /**< Link in the shared injection queue */
+} _task_node;
+
+struct _thread_pool_worker;
+
+/**
+ * @brief Fixed set of worker threads sharing submitted tasks.
+ *
+ * Every worker owns a Chase-Lev deque: tasks submitted from inside a task go
+ * to the submitting worker's deque, where it pops them LIFO without locking
+ * while idle workers steal FIFO from a randomly chosen victim. Tasks
+ * submitted from other threads go through a mutex-protected injection queue.
+ * Workers that find nothing after a short spin park on a condition variable
+ * and cost nothing until new work arrives.
+ */
+typedef struct {
+    struct _thread_pool_worker* workers;    /**< One per thread, cache-line aligned if the allocator can */
+    size_t worker_count;                    /**< Number of worker threads */
+    concurrent_pool_t task_nodes;           /**< Allocator for _task_node */
+    mutex_t lock;                           /**< Guards the injection queue and parking */
+    cond_t wake;                            /**< Signaled when work arrives for parked workers */
+    cond_t idle;                            /**< Broadcast when pending drops to zero */
+    _task_node* inject_head;                /**< Tasks submitted from outside the pool */
+    _task_node* inject_tail;
+    atomicsz_t inject_count;                /**< Read without the lock to skip empty checks */
+    atomicsz_t pending;                     /**< Submitted tasks not yet finished */
+    atomicsz_t sleepers;                    /**< Workers parked or about to park */
+    atomicsz_t waiters;                     /**< Threads blocked in thread_pool_wait */
+    bool stopping;                          /**< Set by thread_pool_destroy */
+} thread_pool_t;
+
+/**
+ * @brief Start a thread pool.
+ * @param pool Pool to initialize.
+ * @param thread_count Worker threads to start, or 0 for thread_hardware_concurrency().
+ * @return false if memory or a thread-local key could not be obtained.
+ */
+DIESEL_API bool thread_pool_init(thread_pool_t* pool, size_t thread_count);
+
+/**
+ * @brief Finish every pending task, then stop and join the workers.
+ * @param pool Pool to destroy. Must not be called from one of its tasks.
+ */
+DIESEL_API void thread_pool_destroy(thread_pool_t* pool);
+
+/**
+ * @brief Queue func(arg) to run on the pool.
+ *
+ * Takes the same signature as thread_create. Safe to call from any thread,
+ * including from inside a running task.
+ *
+ * @return false if the task node could not be allocated; func is not run.
+ */
+DIESEL_API bool thread_pool_submit(thread_pool_t* pool, void (*func)(void*), void* arg);
+
+/**
+ * @brief Block until every task submitted so far, and every task those
+ *        tasks submit, has finished.
+ *
+ * The caller runs queued tasks while it waits and only parks when none are
+ * left to take. Must not be called from a task of the same pool, since that
+ * task itself counts as pending.
+ */
+DIESEL_API void thread_pool_wait(thread_pool_t* pool);
+
+/**
+ * @brief Run at most one queued task on the calling thread.
+ *
+ * Lets a thread that is waiting for some result contribute instead of
+ * blocking. Workers try their own deque first; every caller then tries the
+ * injection queue and stealing.
+ *
+ * @return true if a task was run.
+ */
+DIESEL_API bool thread_pool_help(thread_pool_t* pool);
+
+/**
+ * @brief Index of the calling thread among pool's workers.
+ * @return The worker index, or SIZE_MAX if the caller is not one of pool's workers.
+ */
+DIESEL_API size_t thread_pool_worker_index(const thread_pool_t* pool);
+
+/**
+ * @brief Shared pool sized to the hardware concurrency.
+ *
+ * Created on first use and kept for the life of the process, so library
+ * components share one set of workers instead of each spawning their own.
+ *
+ * @return The pool, or NULL if it could not be created.
+ */
+DIESEL_API thread_pool_t* thread_pool_default(void);
+
+/* -------------------------------------------------------------------------- */
+/*                                Task handles                                */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Reference-counted handle to a result produced on a thread pool.
+ *
+ * A task finishes with a value_t; failures are reported as a VALUE_ERROR
+ * value carrying an error_t. Finishing never takes a lock: the result is
+ * published and the list of continuations is swapped out atomically.
+ * Every function returning a task_t* hands the caller one reference, to be
+ * dropped with task_release.
+ */
+typedef struct task_t task_t;
+
+/**
+ * @brief Run func(arg) on a pool.
+ * @param pool Pool to run on, or NULL for thread_pool_default().
+ * @return New task, or NULL if it could not be allocated or queued.
+ */
+DIESEL_API task_t* task_submit(thread_pool_t* pool, value_t (*func)(void*), void* arg);
+
+/**
+ * @brief Chain func to run on task's result once task finishes.
+ *
+ * func runs on the same pool as task. If task finishes with VALUE_ERROR,
+ * func is skipped and the error becomes the new task's result.
+ *
+ * @return New task, or NULL if it could not be allocated.
+ */
+DIESEL_API task_t* task_then(task_t* task, value_t (*func)(value_t, void*), void* arg);
+
+/**
+ * @brief Task that finishes when every one of tasks has.
+ *
+ * Its result is VALUE_NONE, or the VALUE_ERROR result of the lowest-indexed
+ * failed task. Read individual results with task_result.
+ *
+ * @return New task, or NULL if it could not be allocated.
+ */
+DIESEL_API task_t* task_when_all(task_t** tasks, size_t count);
+
+/**
+ * @brief Task that finishes as soon as any one of tasks has.
+ *
+ * Its result is a VALUE_UINT holding the index of the first task to finish
+ * (VALUE_NONE when count is 0).
+ *
+ * @return New task, or NULL if it could not be allocated.
+ */
+DIESEL_API task_t* task_when_any(task_t** tasks, size_t count);
+
+/**
+ * @brief Poll for completion without blocking.
+ */
+DIESEL_API bool task_is_done(const task_t* task);
+
+/**
+ * @brief Block until task finishes and return its result.
+ *
+ * The caller runs queued pool tasks while it waits. Threads outside the
+ * pool park once there is nothing to help with; pool workers keep helping
+ * and yielding instead, so a wait inside a task cannot starve the pool.
+ */
+DIESEL_API value_t task_wait(task_t* task);
+
+/**
+ * @brief Result of a finished task.
+ * @return The result, or VALUE_NONE if task has not finished.
+ */
+DIESEL_API value_t task_result(const task_t* task);
+
+/**
+ * @brief Take an extra reference to task.
+ * @return task
+ */
+DIESEL_API task_t* task_retain(task_t* task);
+
+/**
+ * @brief Drop a reference; the task is freed with its last reference.
+ *
+ * Releasing does not cancel the task: it still runs, and its continuations
+ * still fire.
+ */
+DIESEL_API void task_release(task_t* task);
+
+/* -------------------------------------------------------------------------- */
+/*                              Parallel loops                                */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Ranges shorter than this run inline on the caller by default.
+ */
+#define PARALLEL_INLINE_CUTOFF 1024
+
+/**
+ * @brief How a parallel loop hands out iterations.
+ */
+typedef enum {
+    PARALLEL_DYNAMIC = 0,   /**< Participants claim chunks from a shared cursor; balances uneven work */
+    PARALLEL_STATIC         /**< One equal contiguous block per participant; deterministic split */
+} parallel_schedule_t;
+
+/**
+ * @brief Tuning for parallel_for_ex and parallel_reduce. Zero-initialize for defaults.
+ */
+typedef struct {
+    thread_pool_t* pool;            /**< Pool to run on, NULL for thread_pool_default() */
+    parallel_schedule_t schedule;   /**< PARALLEL_DYNAMIC unless set */
+    size_t grain;                   /**< Iterations per dynamic chunk, 0 for guided sizing */
+    size_t inline_below;            /**< Inline cutoff, 0 for PARALLEL_INLINE_CUTOFF */
+} parallel_options_t;
+
+/**
+ * @brief Run fn over [begin, end) split across a pool.
+ *
+ * fn receives whole subranges rather than single indices, so its inner loop
+ * stays tight enough to vectorize, e.g. over vec.data[b..e) of a
+ * VECTOR_DEFINE vector. The caller takes part and returns once every
+ * subrange is done. With the default dynamic schedule and no grain, chunk
+ * sizes shrink as the range drains (guided scheduling): large chunks first
+ * to keep claims rare, small ones at the end to balance.
+ *
+ * @param fn Called as fn(chunk_begin, chunk_end, ctx), possibly concurrently.
+ */
+DIESEL_API void parallel_for(size_t begin, size_t end, void (*fn)(size_t, size_t, void*), void* ctx);
+
+/**
+ * @brief parallel_for with explicit options (may be NULL).
+ */
+DIESEL_API void parallel_for_ex(size_t begin, size_t end, void (*fn)(size_t, size_t, void*), void* ctx,
+                                const parallel_options_t* options);
+
+/**
+ * @brief Reduce [begin, end) in parallel.
+ *
+ * Every participant folds its subranges into a private accumulator copied
+ * from the identity, and the accumulators are merged into result in
+ * participant order. With PARALLEL_STATIC the split, and so the result of
+ * a non-associative reduction such as a floating-point sum, is the same on
+ * every run for a given pool size.
+ *
+ * @param result Holds the identity value on entry and the total on return.
+ * @param result_size Size of the accumulator in bytes.
+ * @param map Called as map(chunk_begin, chunk_end, acc, ctx) to fold a subrange into acc.
+ * @param combine Called as combine(acc, other, ctx) to fold other into acc.
+ * @param options Tuning, or NULL for defaults.
+ */
+DIESEL_API void parallel_reduce(size_t begin, size_t end, void* result, size_t result_size,
+                                void (*map)(size_t, size_t, void*, void*),
+                                void (*combine)(void*, const void*, void*),
+                                void* ctx, const parallel_options_t* options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIB_DIESEL_TASKS_H
@@ -0,0 +1,162 @@
+#ifndef LIB_DIESEL_TEXT_H
+#define LIB_DIESEL_TEXT_H
+
+#include <stdarg.h>
+#include "types.h"
+#include "memory.h"
+#include "_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define _TEXT_PRINTF(fmt_index, first_arg) __attribute__((format(printf, fmt_index, first_arg)))
+#else
+    #define _TEXT_PRINTF(fmt_index, first_arg)
+#endif
+
+/* -------------------------------------------------------------------------- */
+/*                              String builder                                */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Growable, always NUL-terminated string buffer.
+ *
+ * Capacity grows geometrically, so a run of appends costs amortized O(1)
+ * allocations. Clearing keeps the buffer for reuse.
+ */
+typedef struct {
+    char* data;         /**< Buffer, NULL until the first append */
+    size_t length;      /**< Characters in use, excluding the terminator */
+    size_t capacity;    /**< Bytes allocated, including the terminator */
+    allocator_t* alloc; /**< Allocator the buffer comes from */
+} string_builder_t;
+
+/**
+ * @brief Initialize an empty builder.
+ * @param sb Builder to initialize.
+ * @param alloc Allocator for the buffer, or NULL for default_allocator.
+ */
+DIESEL_API void string_builder_init(string_builder_t* sb, allocator_t* alloc);
+
+/**
+ * @brief Release the builder's buffer.
+ * @param sb Builder to free.
+ */
+DIESEL_API void string_builder_free(string_builder_t* sb);
+
+/**
+ * @brief Make room for at least extra more characters.
+ * @param sb Builder to grow.
+ * @param extra Characters to reserve beyond the current length.
+ * @return false if allocation failed.
+ */
+DIESEL_API bool string_builder_reserve(string_builder_t* sb, size_t extra);
+
+/**
+ * @brief Append length bytes of str.
+ * @return false if allocation failed; the builder is left unchanged.
+ */
+DIESEL_API bool string_builder_append_n(string_builder_t* sb, const char* str, size_t length);
+
+/**
+ * @brief Append a NUL-terminated string.
+ * @return false if allocation failed; the builder is left unchanged.
+ */
+DIESEL_API bool string_builder_append(string_builder_t* sb, string_t str);
+
+/**
+ * @brief Append a single character.
+ * @return false if allocation failed.
+ */
+DIESEL_API bool string_builder_append_char(string_builder_t* sb, char c);
+
+/**
+ * @brief Append printf-style formatted text.
+ *
+ * Formats straight into the spare capacity, so only output that does not
+ * fit costs a second formatting pass.
+ *
+ * @return false on allocation or formatting failure; the builder is left
+ *         unchanged.
+ */
+DIESEL_API bool string_builder_appendf(string_builder_t* sb, const char* fmt, ...) _TEXT_PRINTF(2, 3);
+
+/**
+ * @brief va_list form of string_builder_appendf.
+ */
+DIESEL_API bool string_builder_appendvf(string_builder_t* sb, const char* fmt, va_list args);
+
+/**
+ * @brief Reset the length to zero, keeping the buffer.
+ */
+DIESEL_API void string_builder_clear(string_builder_t* sb);
+
+/**
+ * @brief Get the current contents.
+ * @return NUL-terminated string, valid until the next modification. Never NULL.
+ */
+DIESEL_API string_t string_builder_cstr(const string_builder_t* sb);
+
+/* -------------------------------------------------------------------------- */
+/*                              String interner                               */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    uint64_t hash;
+    string_t str;
+    size_t length;
+} _interner_slot;
+
+/**
+ * @brief Deduplicating string table.
+ *
+ * Each distinct string is copied once into an arena and handed back as the
+ * same string_t every time, so interned strings can be compared by pointer
+ * and stay valid until the interner is destroyed. Not thread-safe; share one
+ * between threads only under a mutex.
+ */
+typedef struct {
+    arena_t storage;        /**< Arena holding the string bytes */
+    _interner_slot* slots;  /**< Open-addressing table, NULL str = empty */
+    size_t count;           /**< Distinct strings interned */
+    size_t capacity;        /**< Slots in the table, a power of two */
+    allocator_t* alloc;     /**< Allocator for the table */
+} string_interner_t;
+
+/**
+ * @brief Initialize an empty interner.
+ * @param interner Interner to initialize.
+ * @param alloc Allocator for the hash table, or NULL for default_allocator.
+ */
+DIESEL_API void string_interner_init(string_interner_t* interner, allocator_t* alloc);
+
+/**
+ * @brief Free the table and every interned string.
+ */
+DIESEL_API void string_interner_destroy(string_interner_t* interner);
+
+/**
+ * @brief Intern length bytes of str (which need not be NUL-terminated).
+ * @return The canonical NUL-terminated copy, or NULL if allocation failed.
+ */
+DIESEL_API string_t string_intern_n(string_interner_t* interner, const char* str, size_t length);
+
+/**
+ * @brief Intern a NUL-terminated string.
+ * @return The canonical copy, or NULL if allocation failed.
+ */
+DIESEL_API string_t string_intern(string_interner_t* interner, string_t str);
+
+/**
+ * @brief Look a string up without interning it.
+ * @return The canonical copy, or NULL if it was never interned.
+ */
+DIESEL_API string_t string_interner_find(const string_interner_t* interner, const char* str, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIB_DIESEL_TEXT_H
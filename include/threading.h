@@ -11,6 +11,7 @@ extern "C" {
 
 #if defined(DISTRO_WIN32)
 #include <Windows.h>
+#include <intrin.h>
 
 /**
  * @brief Cross-platform thread type
@@ -22,9 +23,22 @@ typedef HANDLE thread_t;
  */
 typedef CRITICAL_SECTION mutex_t;
 
+/**
+ * @brief Cross-platform condition variable type
+ */
+typedef CONDITION_VARIABLE cond_t;
+
+/**
+ * @brief Cross-platform thread-local storage key type
+ */
+typedef DWORD tls_key_t;
+
 #else // POSIX
 #include <pthread.h>
 #include <sched.h>
+#if !defined(__GNUC__) && !defined(__clang__)
+#include <stdatomic.h>
+#endif
 
 /**
  * @brief Cross-platform thread type
@@ -36,8 +50,29 @@ typedef pthread_t thread_t;
  */
 typedef pthread_mutex_t mutex_t;
 
+/**
+ * @brief Cross-platform condition variable type
+ */
+typedef pthread_cond_t cond_t;
+
+/**
+ * @brief Cross-platform thread-local storage key type
+ */
+typedef pthread_key_t tls_key_t;
+
 #endif // DISTRO_WIN32
 
+/**
+ * @brief Storage class for variables with one instance per thread
+ */
+#if defined(_MSC_VER)
+    #define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+    #define THREAD_LOCAL __thread
+#else
+    #define THREAD_LOCAL _Thread_local
+#endif
+
 /**
  * @brief Creates a new thread
  * @param func Pointer to the function to run in the new thread. Signature: void func(void* arg)
@@ -87,6 +122,620 @@ DIESEL_API void mutex_unlock(mutex_t* mutex);
  */
 DIESEL_API void mutex_destroy(mutex_t* mutex);
 
+/**
+ * @brief Initializes a condition variable
+ * @param cond Pointer to the condition variable to initialize
+ * @return void
+ */
+DIESEL_API void cond_init(cond_t* cond);
+
+/**
+ * @brief Atomically unlocks mutex and waits for the condition to be signaled
+ * @param cond Pointer to the condition variable to wait on
+ * @param mutex Pointer to a mutex locked by the caller; locked again on return
+ * @return void
+ * @note Wakeups can be spurious, so always wait in a loop that rechecks the condition
+ */
+DIESEL_API void cond_wait(cond_t* cond, mutex_t* mutex);
+
+/**
+ * @brief Wakes one thread waiting on a condition variable
+ * @param cond Pointer to the condition variable to signal
+ * @return void
+ */
+DIESEL_API void cond_signal(cond_t* cond);
+
+/**
+ * @brief Wakes every thread waiting on a condition variable
+ * @param cond Pointer to the condition variable to broadcast
+ * @return void
+ */
+DIESEL_API void cond_broadcast(cond_t* cond);
+
+/**
+ * @brief Destroys a condition variable
+ * @param cond Pointer to the condition variable to destroy
+ * @return void
+ */
+DIESEL_API void cond_destroy(cond_t* cond);
+
+/**
+ * @brief Gets the number of hardware threads available to the process
+ * @return The number of logical processors online, at least 1
+ */
+DIESEL_API size_t thread_hardware_concurrency(void);
+
+/**
+ * @brief Creates a thread-local storage key
+ * @param key Pointer to the key to initialize
+ * @param destructor Called with a thread's non-NULL value when that thread exits. May be NULL
+ * @return true on success, false if no more keys are available
+ */
+DIESEL_API bool tls_create(tls_key_t* key, void (*destructor)(void*));
+
+/**
+ * @brief Gets the calling thread's value for a key
+ * @param key The key to look up
+ * @return The value set by this thread, or NULL if none was set
+ */
+DIESEL_API void* tls_get(tls_key_t key);
+
+/**
+ * @brief Sets the calling thread's value for a key
+ * @param key The key to set
+ * @param value The value to store
+ * @return void
+ */
+DIESEL_API void tls_set(tls_key_t key, void* value);
+
+/**
+ * @brief Destroys a thread-local storage key
+ * @param key The key to destroy
+ * @return void
+ */
+DIESEL_API void tls_destroy(tls_key_t key);
+
+// -------------------- Atomics --------------------
+
+/**
+ * @brief Memory ordering for atomic operations, with C11 semantics
+ *
+ * The values match GCC's __ATOMIC_* constants so the builtin backend can
+ * pass them straight through.
+ */
+typedef enum {
+    MEMORY_ORDER_RELAXED = 0,   ///< Atomicity only, no ordering
+    MEMORY_ORDER_ACQUIRE = 2,   ///< Later accesses stay after this load
+    MEMORY_ORDER_RELEASE = 3,   ///< Earlier accesses stay before this store
+    MEMORY_ORDER_ACQ_REL = 4,   ///< Both, for read-modify-write operations
+    MEMORY_ORDER_SEQ_CST = 5    ///< Acquire/release plus a single total order
+} memory_order_t;
+
+/*
+ * Typed atomic wrappers. Each type is a struct around one value so it can
+ * only be touched through the functions below:
+ *
+ *   atomic32_t  (int32_t)   atomic64_t  (int64_t)
+ *   atomicsz_t  (size_t)    atomicptr_t (void*)
+ *
+ * Every type has <prefix>_init (plain, non-atomic initialization), _load,
+ * _store, _exchange, _compare_exchange and _compare_exchange_weak. The
+ * integer types add _fetch_add, _fetch_sub, _fetch_and and _fetch_or, which
+ * return the previous value. compare_exchange writes the observed value to
+ * *expected on failure. Backends: Interlocked* on DISTRO_WIN32, GCC __atomic
+ * builtins on GCC and Clang, and <stdatomic.h> elsewhere.
+ */
+
+#if defined(DISTRO_WIN32)
+    /* x86 is TSO: only the compiler needs restraining for acquire/release */
+    #if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+        #define _ATOMIC_WIN_BARRIER() _ReadWriteBarrier()
+    #else
+        #define _ATOMIC_WIN_BARRIER() MemoryBarrier()
+    #endif
+
+    #define _ATOMIC_WIN_LOAD_32(p)          (*(p))
+    #define _ATOMIC_WIN_STORE_32(p, v)      (*(p) = (v))
+    #define _ATOMIC_WIN_XCHG_32(p, v)       InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+    #define _ATOMIC_WIN_CAS_32(p, d, e)     InterlockedCompareExchange((volatile LONG*)(p), (LONG)(d), (LONG)(e))
+    #define _ATOMIC_WIN_ADD_32(p, v)        InterlockedExchangeAdd((volatile LONG*)(p), (LONG)(v))
+    #define _ATOMIC_WIN_AND_32(p, v)        InterlockedAnd((volatile LONG*)(p), (LONG)(v))
+    #define _ATOMIC_WIN_OR_32(p, v)         InterlockedOr((volatile LONG*)(p), (LONG)(v))
+
+    /* 64-bit plain loads and stores tear on 32-bit Windows */
+    #if defined(_WIN64)
+        #define _ATOMIC_WIN_LOAD_64(p)      (*(p))
+        #define _ATOMIC_WIN_STORE_64(p, v)  (*(p) = (v))
+    #else
+        #define _ATOMIC_WIN_LOAD_64(p)      InterlockedCompareExchange64((volatile LONG64*)(p), 0, 0)
+        #define _ATOMIC_WIN_STORE_64(p, v)  ((void)InterlockedExchange64((volatile LONG64*)(p), (LONG64)(v)))
+    #endif
+    #define _ATOMIC_WIN_XCHG_64(p, v)       InterlockedExchange64((volatile LONG64*)(p), (LONG64)(v))
+    #define _ATOMIC_WIN_CAS_64(p, d, e)     InterlockedCompareExchange64((volatile LONG64*)(p), (LONG64)(d), (LONG64)(e))
+    #define _ATOMIC_WIN_ADD_64(p, v)        InterlockedExchangeAdd64((volatile LONG64*)(p), (LONG64)(v))
+    #define _ATOMIC_WIN_AND_64(p, v)        InterlockedAnd64((volatile LONG64*)(p), (LONG64)(v))
+    #define _ATOMIC_WIN_OR_64(p, v)         InterlockedOr64((volatile LONG64*)(p), (LONG64)(v))
+
+    #define _ATOMIC_WIN_LOAD_PTR(p)         (*(p))
+    #define _ATOMIC_WIN_STORE_PTR(p, v)     (*(p) = (v))
+    #define _ATOMIC_WIN_XCHG_PTR(p, v)      InterlockedExchangePointer((PVOID volatile*)(p), (PVOID)(v))
+    #define _ATOMIC_WIN_CAS_PTR(p, d, e)    InterlockedCompareExchangePointer((PVOID volatile*)(p), (PVOID)(d), (PVOID)(e))
+
+    #if defined(_WIN64)
+        #define _ATOMIC_SZ_WIDTH 64
+    #else
+        #define _ATOMIC_SZ_WIDTH 32
+    #endif
+    #define _ATOMIC_CAT_(a, b) a##b
+    #define _ATOMIC_CAT(a, b) _ATOMIC_CAT_(a, b)
+
+    #define _ATOMIC_DEFINE_BASE(Prefix, Type, T, W)                                \
+    typedef struct { volatile T value; } Type;                                     \
+                                                                                   \
+    static inline void Prefix##_init(Type* a, T value) { a->value = value; }       \
+                                                                                   \
+    static inline T Prefix##_load(const Type* a, memory_order_t order) {           \
+        T value = (T)_ATOMIC_CAT(_ATOMIC_WIN_LOAD_, W)(&a->value);                 \
+        if (order != MEMORY_ORDER_RELAXED) _ATOMIC_WIN_BARRIER();                  \
+        return value;                                                              \
+    }                                                                              \
+                                                                                   \
+    static inline void Prefix##_store(Type* a, T value, memory_order_t order) {    \
+        if (order == MEMORY_ORDER_SEQ_CST) {                                       \
+            (void)_ATOMIC_CAT(_ATOMIC_WIN_XCHG_, W)(&a->value, value);             \
+            return;                                                                \
+        }                                                                          \
+        if (order != MEMORY_ORDER_RELAXED) _ATOMIC_WIN_BARRIER();                  \
+        _ATOMIC_CAT(_ATOMIC_WIN_STORE_, W)(&a->value, value);                      \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_exchange(Type* a, T value, memory_order_t order) {    \
+        (void)order;                                                               \
+        return (T)_ATOMIC_CAT(_ATOMIC_WIN_XCHG_, W)(&a->value, value);             \
+    }                                                                              \
+                                                                                   \
+    static inline bool Prefix##_compare_exchange(Type* a, T* expected, T desired,  \
+                                                 memory_order_t success,           \
+                                                 memory_order_t failure) {         \
+        (void)success; (void)failure;                                              \
+        T previous = (T)_ATOMIC_CAT(_ATOMIC_WIN_CAS_, W)(&a->value, desired, *expected); \
+        if (previous == *expected) return true;                                    \
+        *expected = previous;                                                      \
+        return false;                                                              \
+    }                                                                              \
+                                                                                   \
+    static inline bool Prefix##_compare_exchange_weak(Type* a, T* expected, T desired, \
+                                                      memory_order_t success,      \
+                                                      memory_order_t failure) {    \
+        return Prefix##_compare_exchange(a, expected, desired, success, failure);  \
+    }
+
+    #define _ATOMIC_DEFINE_INT(Prefix, Type, T, W)                                 \
+    _ATOMIC_DEFINE_BASE(Prefix, Type, T, W)                                        \
+                                                                                   \
+    static inline T Prefix##_fetch_add(Type* a, T value, memory_order_t order) {   \
+        (void)order;                                                               \
+        return (T)_ATOMIC_CAT(_ATOMIC_WIN_ADD_, W)(&a->value, value);              \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_sub(Type* a, T value, memory_order_t order) {   \
+        (void)order;                                                               \
+        return (T)_ATOMIC_CAT(_ATOMIC_WIN_ADD_, W)(&a->value, (T)0 - value);       \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_and(Type* a, T value, memory_order_t order) {   \
+        (void)order;                                                               \
+        return (T)_ATOMIC_CAT(_ATOMIC_WIN_AND_, W)(&a->value, value);              \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_or(Type* a, T value, memory_order_t order) {    \
+        (void)order;                                                               \
+        return (T)_ATOMIC_CAT(_ATOMIC_WIN_OR_, W)(&a->value, value);               \
+    }
+
+    _ATOMIC_DEFINE_INT(atomic32, atomic32_t, int32_t, 32)
+    _ATOMIC_DEFINE_INT(atomic64, atomic64_t, int64_t, 64)
+    _ATOMIC_DEFINE_INT(atomicsz, atomicsz_t, size_t, _ATOMIC_SZ_WIDTH)
+    /* Through a typedef, volatile qualifies the pointer itself; spelled out
+     * as volatile void* it would qualify the pointee instead. */
+    typedef void* _atomic_ptr_raw;
+    _ATOMIC_DEFINE_BASE(atomicptr, atomicptr_t, _atomic_ptr_raw, PTR)
+
+    static inline void atomic_fence(memory_order_t order) {
+        if (order == MEMORY_ORDER_SEQ_CST) MemoryBarrier();
+        else if (order != MEMORY_ORDER_RELAXED) _ATOMIC_WIN_BARRIER();
+    }
+
+    static inline void atomic_compiler_fence(void) {
+        _ReadWriteBarrier();
+    }
+
+#elif defined(__GNUC__) || defined(__clang__)
+
+    #define _ATOMIC_DEFINE_BASE(Prefix, Type, T)                                   \
+    typedef struct { T value; } Type;                                              \
+                                                                                   \
+    static inline void Prefix##_init(Type* a, T value) { a->value = value; }       \
+                                                                                   \
+    static inline T Prefix##_load(const Type* a, memory_order_t order) {           \
+        return __atomic_load_n(&a->value, (int)order);                             \
+    }                                                                              \
+                                                                                   \
+    static inline void Prefix##_store(Type* a, T value, memory_order_t order) {    \
+        __atomic_store_n(&a->value, value, (int)order);                            \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_exchange(Type* a, T value, memory_order_t order) {    \
+        return __atomic_exchange_n(&a->value, value, (int)order);                  \
+    }                                                                              \
+                                                                                   \
+    static inline bool Prefix##_compare_exchange(Type* a, T* expected, T desired,  \
+                                                 memory_order_t success,           \
+                                                 memory_order_t failure) {         \
+        return __atomic_compare_exchange_n(&a->value, expected, desired, false,    \
+                                           (int)success, (int)failure);            \
+    }                                                                              \
+                                                                                   \
+    static inline bool Prefix##_compare_exchange_weak(Type* a, T* expected, T desired, \
+                                                      memory_order_t success,      \
+                                                      memory_order_t failure) {    \
+        return __atomic_compare_exchange_n(&a->value, expected, desired, true,     \
+                                           (int)success, (int)failure);            \
+    }
+
+    #define _ATOMIC_DEFINE_INT(Prefix, Type, T)                                    \
+    _ATOMIC_DEFINE_BASE(Prefix, Type, T)                                           \
+                                                                                   \
+    static inline T Prefix##_fetch_add(Type* a, T value, memory_order_t order) {   \
+        return __atomic_fetch_add(&a->value, value, (int)order);                   \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_sub(Type* a, T value, memory_order_t order) {   \
+        return __atomic_fetch_sub(&a->value, value, (int)order);                   \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_and(Type* a, T value, memory_order_t order) {   \
+        return __atomic_fetch_and(&a->value, value, (int)order);                   \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_or(Type* a, T value, memory_order_t order) {    \
+        return __atomic_fetch_or(&a->value, value, (int)order);                    \
+    }
+
+    _ATOMIC_DEFINE_INT(atomic32, atomic32_t, int32_t)
+    _ATOMIC_DEFINE_INT(atomic64, atomic64_t, int64_t)
+    _ATOMIC_DEFINE_INT(atomicsz, atomicsz_t, size_t)
+    _ATOMIC_DEFINE_BASE(atomicptr, atomicptr_t, void*)
+
+    static inline void atomic_fence(memory_order_t order) {
+        __atomic_thread_fence((int)order);
+    }
+
+    static inline void atomic_compiler_fence(void) {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    }
+
+#else
+    static inline memory_order _atomic_order(memory_order_t order) {
+        switch (order) {
+        case MEMORY_ORDER_RELAXED: return memory_order_relaxed;
+        case MEMORY_ORDER_ACQUIRE: return memory_order_acquire;
+        case MEMORY_ORDER_RELEASE: return memory_order_release;
+        case MEMORY_ORDER_ACQ_REL: return memory_order_acq_rel;
+        default:                   return memory_order_seq_cst;
+        }
+    }
+
+    #define _ATOMIC_DEFINE_BASE(Prefix, Type, T)                                   \
+    typedef struct { _Atomic(T) value; } Type;                                     \
+                                                                                   \
+    static inline void Prefix##_init(Type* a, T value) { atomic_init(&a->value, value); } \
+                                                                                   \
+    static inline T Prefix##_load(const Type* a, memory_order_t order) {           \
+        return atomic_load_explicit((_Atomic(T)*)&a->value, _atomic_order(order)); \
+    }                                                                              \
+                                                                                   \
+    static inline void Prefix##_store(Type* a, T value, memory_order_t order) {    \
+        atomic_store_explicit(&a->value, value, _atomic_order(order));             \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_exchange(Type* a, T value, memory_order_t order) {    \
+        return atomic_exchange_explicit(&a->value, value, _atomic_order(order));   \
+    }                                                                              \
+                                                                                   \
+    static inline bool Prefix##_compare_exchange(Type* a, T* expected, T desired,  \
+                                                 memory_order_t success,           \
+                                                 memory_order_t failure) {         \
+        return atomic_compare_exchange_strong_explicit(&a->value, expected, desired, \
+                   _atomic_order(success), _atomic_order(failure));                \
+    }                                                                              \
+                                                                                   \
+    static inline bool Prefix##_compare_exchange_weak(Type* a, T* expected, T desired, \
+                                                      memory_order_t success,      \
+                                                      memory_order_t failure) {    \
+        return atomic_compare_exchange_weak_explicit(&a->value, expected, desired, \
+                   _atomic_order(success), _atomic_order(failure));                \
+    }
+
+    #define _ATOMIC_DEFINE_INT(Prefix, Type, T)                                    \
+    _ATOMIC_DEFINE_BASE(Prefix, Type, T)                                           \
+                                                                                   \
+    static inline T Prefix##_fetch_add(Type* a, T value, memory_order_t order) {   \
+        return atomic_fetch_add_explicit(&a->value, value, _atomic_order(order));  \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_sub(Type* a, T value, memory_order_t order) {   \
+        return atomic_fetch_sub_explicit(&a->value, value, _atomic_order(order));  \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_and(Type* a, T value, memory_order_t order) {   \
+        return atomic_fetch_and_explicit(&a->value, value, _atomic_order(order));  \
+    }                                                                              \
+                                                                                   \
+    static inline T Prefix##_fetch_or(Type* a, T value, memory_order_t order) {    \
+        return atomic_fetch_or_explicit(&a->value, value, _atomic_order(order));   \
+    }
+
+    _ATOMIC_DEFINE_INT(atomic32, atomic32_t, int32_t)
+    _ATOMIC_DEFINE_INT(atomic64, atomic64_t, int64_t)
+    _ATOMIC_DEFINE_INT(atomicsz, atomicsz_t, size_t)
+    _ATOMIC_DEFINE_BASE(atomicptr, atomicptr_t, void*)
+
+    static inline void atomic_fence(memory_order_t order) {
+        atomic_thread_fence(_atomic_order(order));
+    }
+
+    static inline void atomic_compiler_fence(void) {
+        atomic_signal_fence(memory_order_seq_cst);
+    }
+
+#endif // DISTRO_WIN32
+
+
+// -------------------- Locks --------------------
+
+/**
+ * @brief Tells the CPU the caller is busy-waiting (pause/yield instruction)
+ * @return void
+ */
+static inline void cpu_relax(void) {
+#if defined(_MSC_VER)
+    YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    atomic_compiler_fence();
+#endif
+}
+
+/**
+ * @brief Blocks while *a still equals expected
+ * @param a Word to wait on
+ * @param expected Value the caller last saw; returns at once if *a differs
+ * @return void
+ * @note Uses futex on Linux and WaitOnAddress on Windows. Wakeups can be
+ *       spurious, so always wait in a loop that rechecks the value
+ */
+DIESEL_API void atomic32_wait(atomic32_t* a, int32_t expected);
+
+/**
+ * @brief Wakes one thread blocked in atomic32_wait on a
+ * @param a Word the waiters are blocked on. Only its address is used, so it
+ *          may already have gone out of scope
+ * @return void
+ */
+DIESEL_API void atomic32_wake_one(atomic32_t* a);
+
+/**
+ * @brief Wakes every thread blocked in atomic32_wait on a
+ * @param a Word the waiters are blocked on. Only its address is used
+ * @return void
+ */
+DIESEL_API void atomic32_wake_all(atomic32_t* a);
+
+/**
+ * @brief Upper bound on cpu_relax calls between two polls of a contended lock
+ */
+#define SPIN_BACKOFF_LIMIT 64
+
+/**
+ * @brief Test-and-test-and-set lock, one 32-bit word
+ *
+ * Never parks: waiters back off exponentially and yield the CPU once the
+ * backoff is saturated. Only for critical sections of a few instructions.
+ */
+typedef struct {
+    atomic32_t state;   ///< 0 unlocked, 1 locked
+} spinlock_t;
+
+/**
+ * @brief Static initializer for an unlocked spinlock_t
+ */
+#define SPINLOCK_INIT { { 0 } }
+
+/**
+ * @brief Initializes a spinlock
+ * @param lock Pointer to the lock to initialize
+ * @return void
+ */
+static inline void spinlock_init(spinlock_t* lock) {
+    atomic32_init(&lock->state, 0);
+}
+
+/**
+ * @brief Takes a spinlock if it is free
+ * @param lock Pointer to the lock
+ * @return true if the lock was taken
+ */
+static inline bool spinlock_try_lock(spinlock_t* lock) {
+    return atomic32_load(&lock->state, MEMORY_ORDER_RELAXED) == 0 &&
+           atomic32_exchange(&lock->state, 1, MEMORY_ORDER_ACQUIRE) == 0;
+}
+
+/**
+ * @brief Locks a spinlock
+ * @param lock Pointer to the lock
+ * @return void
+ */
+static inline void spinlock_lock(spinlock_t* lock) {
+    int backoff = 1;
+    while (atomic32_exchange(&lock->state, 1, MEMORY_ORDER_ACQUIRE) != 0) {
+        /* Wait on a plain load so the cache line stays shared until release */
+        do {
+            if (backoff < SPIN_BACKOFF_LIMIT) {
+                for (int i = 0; i < backoff; i++) cpu_relax();
+                backoff *= 2;
+            } else {
+                thread_yield();
+            }
+        } while (atomic32_load(&lock->state, MEMORY_ORDER_RELAXED) != 0);
+    }
+}
+
+/**
+ * @brief Unlocks a spinlock
+ * @param lock Pointer to the lock
+ * @return void
+ */
+static inline void spinlock_unlock(spinlock_t* lock) {
+    atomic32_store(&lock->state, 0, MEMORY_ORDER_RELEASE);
+}
+
+/**
+ * @brief Spin-then-park mutex, one 32-bit word and no destructor
+ *
+ * The uncontended lock and unlock are a single atomic instruction inline.
+ * A contended lock spins with exponential backoff for about as long as a
+ * short critical section takes, then parks with atomic32_wait, so it can be
+ * embedded per bucket or per object where a mutex_t would be too large.
+ * Not recursive and not fair; see ticket_lock_t for a fair lock.
+ */
+typedef struct {
+    atomic32_t state;   ///< 0 unlocked, 1 locked, 2 locked with possible sleepers
+} adaptive_mutex_t;
+
+/**
+ * @brief Static initializer for an unlocked adaptive_mutex_t
+ */
+#define ADAPTIVE_MUTEX_INIT { { 0 } }
+
+/**
+ * @brief Contended path of adaptive_mutex_lock
+ * @param mutex Pointer to the mutex to lock
+ * @return void
+ */
+DIESEL_API void adaptive_mutex_lock_slow(adaptive_mutex_t* mutex);
+
+/**
+ * @brief Initializes an adaptive mutex
+ * @param mutex Pointer to the mutex to initialize
+ * @return void
+ */
+static inline void adaptive_mutex_init(adaptive_mutex_t* mutex) {
+    atomic32_init(&mutex->state, 0);
+}
+
+/**
+ * @brief Takes an adaptive mutex if it is free
+ * @param mutex Pointer to the mutex
+ * @return true if the mutex was taken
+ */
+static inline bool adaptive_mutex_try_lock(adaptive_mutex_t* mutex) {
+    int32_t expected = 0;
+    return atomic32_compare_exchange(&mutex->state, &expected, 1,
+                                     MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_RELAXED);
+}
+
+/**
+ * @brief Locks an adaptive mutex
+ * @param mutex Pointer to the mutex to lock
+ * @return void
+ */
+static inline void adaptive_mutex_lock(adaptive_mutex_t* mutex) {
+    if (!adaptive_mutex_try_lock(mutex)) adaptive_mutex_lock_slow(mutex);
+}
+
+/**
+ * @brief Unlocks an adaptive mutex, waking one parked waiter if there is one
+ * @param mutex Pointer to the mutex to unlock
+ * @return void
+ */
+static inline void adaptive_mutex_unlock(adaptive_mutex_t* mutex) {
+    if (atomic32_exchange(&mutex->state, 0, MEMORY_ORDER_RELEASE) == 2) {
+        atomic32_wake_one(&mutex->state);
+    }
+}
+
+/**
+ * @brief Fair FIFO lock, two 32-bit counters
+ *
+ * Threads are served in the order they arrived, so no waiter can starve
+ * under heavy contention. Waiters spin with backoff proportional to their
+ * place in line and yield once it grows long, but never park.
+ */
+typedef struct {
+    atomic32_t next;      ///< Ticket handed to the next arriving thread
+    atomic32_t serving;   ///< Ticket currently allowed to hold the lock
+} ticket_lock_t;
+
+/**
+ * @brief Static initializer for an unlocked ticket_lock_t
+ */
+#define TICKET_LOCK_INIT { { 0 }, { 0 } }
+
+/**
+ * @brief Contended path of ticket_lock_lock
+ * @param lock Pointer to the lock
+ * @param ticket Ticket drawn by the caller
+ * @return void
+ */
+DIESEL_API void ticket_lock_wait(ticket_lock_t* lock, int32_t ticket);
+
+/**
+ * @brief Initializes a ticket lock
+ * @param lock Pointer to the lock to initialize
+ * @return void
+ */
+static inline void ticket_lock_init(ticket_lock_t* lock) {
+    atomic32_init(&lock->next, 0);
+    atomic32_init(&lock->serving, 0);
+}
+
+/**
+ * @brief Takes a ticket lock if nobody holds or waits for it
+ * @param lock Pointer to the lock
+ * @return true if the lock was taken
+ */
+static inline bool ticket_lock_try_lock(ticket_lock_t* lock) {
+    int32_t serving = atomic32_load(&lock->serving, MEMORY_ORDER_RELAXED);
+    int32_t expected = serving;
+    return atomic32_compare_exchange(&lock->next, &expected, (int32_t)((uint32_t)serving + 1),
+                                     MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_RELAXED);
+}
+
+/**
+ * @brief Locks a ticket lock, after every thread that arrived earlier
+ * @param lock Pointer to the lock
+ * @return void
+ */
+static inline void ticket_lock_lock(ticket_lock_t* lock) {
+    int32_t ticket = atomic32_fetch_add(&lock->next, 1, MEMORY_ORDER_RELAXED);
+    if (atomic32_load(&lock->serving, MEMORY_ORDER_ACQUIRE) != ticket) ticket_lock_wait(lock, ticket);
+}
+
+/**
+ * @brief Unlocks a ticket lock, handing it to the next thread in line
+ * @param lock Pointer to the lock
+ * @return void
+ */
+static inline void ticket_lock_unlock(ticket_lock_t* lock) {
+    int32_t serving = atomic32_load(&lock->serving, MEMORY_ORDER_RELAXED);
+    atomic32_store(&lock->serving, (int32_t)((uint32_t)serving + 1), MEMORY_ORDER_RELEASE);
+}
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,14 @@
 #include "memory.h"
+#include "platform.h"
+#include "threading.h"
 #include <stdlib.h>
 #include <string.h>
+#if defined(DISTRO_WIN32)
+    #include <malloc.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
 
 /* -------------------------------------------------------------------------- */
 /* Cross-platform constructor/destructor macros                                */
@@ -27,20 +35,20 @@
 
 /* ------------------------------ Forward Declarations ---------------------- */
 void* arena_alloc(void* ctx, size_t size);
+void* arena_alloc_aligned(void* ctx, size_t size, size_t alignment);
 void arena_free(void* ctx, void* ptr);
 void* arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
 void arena_free_all_fn(void* ctx);
 
 /* ------------------------------ Arena Implementation ---------------------- */
+/* The block header and its data share one allocation so the bump pointer and
+ * the bytes it hands out sit next to each other in memory. */
 static _arena_block* _arena_block_create(size_t min_size, size_t default_block_size) {
     size_t size = (min_size > default_block_size) ? min_size : default_block_size;
-    _arena_block* block = malloc(sizeof(_arena_block));
+    if (size > SIZE_MAX - sizeof(_arena_block)) return NULL;
+    _arena_block* block = malloc(sizeof(_arena_block) + size);
     if (!block) return NULL;
-    block->data = malloc(size);
-    if (!block->data) {
-        free(block);
-        return NULL;
-    }
+    block->data = block + 1;
     block->size = size;
     block->used = 0;
     block->next = NULL;
@@ -49,47 +57,107 @@ static _arena_block* _arena_block_create(size_t min_size, size_t default_block_s
 
 void arena_init(arena_t* arena, size_t block_size) {
     arena->block_size = block_size ? block_size : 1024;
+    arena->next_block_size = arena->block_size;
     arena->root_block = NULL;
+    arena->current_block = NULL;
 }
 
 void arena_destroy(arena_t* arena) {
     _arena_block* block = arena->root_block;
     while (block) {
         _arena_block* next = block->next;
-        free(block->data);
         free(block);
         block = next;
     }
     arena->root_block = NULL;
+    arena->current_block = NULL;
+    arena->next_block_size = arena->block_size;
 }
 
+/* Everything after current_block is treated as free, so a reset only has to
+ * move the cursor back to the first block. */
 void arena_reset(arena_t* arena) {
-    _arena_block* block = arena->root_block;
-    while (block) {
-        block->used = 0;
-        block = block->next;
+    arena->current_block = arena->root_block;
+    if (arena->current_block) arena->current_block->used = 0;
+}
+
+arena_mark_t arena_mark(arena_t* arena) {
+    arena_mark_t mark;
+    mark.block = arena->current_block;
+    mark.used = mark.block ? mark.block->used : 0;
+    return mark;
+}
+
+/* Blocks after the marked one become free simply by moving the cursor back,
+ * the same way arena_reset does. */
+void arena_rewind_to(arena_t* arena, arena_mark_t mark) {
+    if (!mark.block) {
+        arena_reset(arena);
+        return;
     }
+    arena->current_block = mark.block;
+    mark.block->used = mark.used;
 }
 
-void* arena_malloc(arena_t* arena, size_t size) {
-    if (!arena || size == 0) return NULL;
-    _arena_block* block = arena->root_block;
+/* Carve size bytes at the given alignment out of a block, or NULL if the
+ * block does not have room for them. */
+static inline void* _arena_bump(_arena_block* block, size_t size, size_t alignment) {
+    uintptr_t base = (uintptr_t)block->data;
+    uintptr_t start = ALIGN_UP(base + block->used, alignment);
+    size_t end = (size_t)(start - base) + size;
+    if (end > block->size || end < size) return NULL;
+    block->used = end;
+    return (void*)start;
+}
 
-    while (block) {
-        if (block->size - block->used >= size) {
-            void* ptr = (char*)block->data + block->used;
-            block->used += size;
+/* Slow path: the current block is full. Move to the next free block if it is
+ * big enough, otherwise splice a new, larger block in right after the cursor. */
+static void* _arena_malloc_slow(arena_t* arena, size_t size, size_t alignment) {
+    _arena_block* block = arena->current_block;
+    _arena_block* next = block ? block->next : arena->root_block;
+
+    if (next) {
+        next->used = 0;
+        void* ptr = _arena_bump(next, size, alignment);
+        if (ptr) {
+            arena->current_block = next;
             return ptr;
         }
-        block = block->next;
     }
 
-    _arena_block* new_block = _arena_block_create(size, arena->block_size);
+    /* Block data is only guaranteed MEM_DEFAULT_ALIGNMENT, leave room to pad */
+    size_t padded = size + (alignment > MEM_DEFAULT_ALIGNMENT ? alignment - 1 : 0);
+    if (padded < size) return NULL;
+    _arena_block* new_block = _arena_block_create(padded, arena->next_block_size);
     if (!new_block) return NULL;
-    new_block->used = size;
-    new_block->next = arena->root_block;
-    arena->root_block = new_block;
-    return new_block->data;
+    if (arena->next_block_size < ARENA_MAX_BLOCK_SIZE) {
+        arena->next_block_size *= 2;
+        if (arena->next_block_size > ARENA_MAX_BLOCK_SIZE) arena->next_block_size = ARENA_MAX_BLOCK_SIZE;
+    }
+
+    new_block->next = next;
+    if (block) block->next = new_block;
+    else arena->root_block = new_block;
+    arena->current_block = new_block;
+    return _arena_bump(new_block, size, alignment);
+}
+
+void* arena_malloc_aligned(arena_t* arena, size_t size, size_t alignment) {
+    if (!arena || size == 0) return NULL;
+    if (alignment < MEM_DEFAULT_ALIGNMENT) alignment = MEM_DEFAULT_ALIGNMENT;
+    if (alignment & (alignment - 1)) return NULL;
+
+    _arena_block* block = arena->current_block;
+    if (block) {
+        void* ptr = _arena_bump(block, size, alignment);
+        if (ptr) return ptr;
+    }
+
+    return _arena_malloc_slow(arena, size, alignment);
+}
+
+void* arena_malloc(arena_t* arena, size_t size) {
+    return arena_malloc_aligned(arena, size, MEM_DEFAULT_ALIGNMENT);
 }
 
 /* Arena allocator functions */
@@ -97,6 +165,10 @@ void* arena_alloc(void* ctx, size_t size) {
     return arena_malloc((arena_t*)ctx, size);
 }
 
+void* arena_alloc_aligned(void* ctx, size_t size, size_t alignment) {
+    return arena_malloc_aligned((arena_t*)ctx, size, alignment);
+}
+
 void arena_free(void* ctx, void* ptr) {
     (void)ctx;
     (void)ptr;
@@ -107,13 +179,863 @@ void arena_free_all_fn(void* ctx) {
     arena_reset((arena_t*)ctx);
 }
 
+/* When ptr is the most recent allocation it ends exactly at the bump
+ * pointer, so it can grow or shrink in place. */
 void* arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
-    void* new_ptr = arena_malloc((arena_t*)ctx, new_size);
+    arena_t* arena = (arena_t*)ctx;
+    _arena_block* block = arena->current_block;
+    if (ptr && block && (char*)ptr + old_size == (char*)block->data + block->used) {
+        size_t start = (size_t)((char*)ptr - (char*)block->data);
+        if (new_size <= block->size - start) {
+            block->used = start + new_size;
+            return new_size ? ptr : NULL;
+        }
+    }
+    if (!new_size) return NULL;
+
+    void* new_ptr = arena_malloc(arena, new_size);
     if (ptr && new_ptr && old_size) memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
     return new_ptr;
 }
 
+allocator_t arena_allocator(arena_t* arena) {
+    allocator_t a = {
+        .alloc = arena_alloc,
+        .free = arena_free,
+        .free_all = arena_free_all_fn,
+        .realloc = arena_realloc,
+        .ctx = arena,
+        .alloc_aligned = arena_alloc_aligned
+    };
+    return a;
+}
+
+/* ------------------------------ Virtual Memory Arena ---------------------- */
+#define _VM_COMMIT_CHUNK ((size_t)64 * 1024)
+#define _VM_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+static size_t _vm_page_size(void) {
+#if defined(DISTRO_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static void* _vm_reserve(size_t size, int flags, bool* committed) {
+    *committed = false;
+#if defined(DISTRO_WIN32)
+    if (flags & VM_ARENA_HUGE_PAGES) {
+        /* Large pages cannot be committed lazily on Windows, and need the
+         * SeLockMemoryPrivilege; fall back to regular pages without it. */
+        void* ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (ptr) {
+            *committed = true;
+            return ptr;
+        }
+    }
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* ptr = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    /* No MAP_NORESERVE here: hugetlb pages must be reserved at map time or a
+     * later fault would SIGBUS once the huge page pool runs dry. */
+    if (flags & VM_ARENA_HUGE_PAGES) {
+        ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED) return NULL;
+#if defined(MADV_HUGEPAGE)
+        if (flags & (VM_ARENA_TRANSPARENT_HUGE | VM_ARENA_HUGE_PAGES)) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    }
+    return ptr;
+#endif
+}
+
+static bool _vm_commit(char* ptr, size_t size) {
+#if defined(DISTRO_WIN32)
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+bool vm_arena_init(vm_arena_t* arena, size_t reserve_size, int flags) {
+    bool huge = (flags & (VM_ARENA_TRANSPARENT_HUGE | VM_ARENA_HUGE_PAGES)) != 0;
+    size_t granularity = huge ? _VM_HUGE_PAGE_SIZE : _VM_COMMIT_CHUNK;
+    size_t page = _vm_page_size();
+    if (granularity < page) granularity = page;
+
+    bool committed = false;
+    reserve_size = ALIGN_UP(reserve_size ? reserve_size : granularity, granularity);
+    arena->base = _vm_reserve(reserve_size, flags, &committed);
+    if (!arena->base) return false;
+
+    arena->reserved = reserve_size;
+    arena->committed = committed ? reserve_size : 0;
+    arena->used = 0;
+    arena->granularity = granularity;
+    arena->flags = flags;
+    return true;
+}
+
+void vm_arena_destroy(vm_arena_t* arena) {
+    if (!arena->base) return;
+#if defined(DISTRO_WIN32)
+    VirtualFree(arena->base, 0, MEM_RELEASE);
+#else
+    munmap(arena->base, arena->reserved);
+#endif
+    arena->base = NULL;
+    arena->reserved = 0;
+    arena->committed = 0;
+    arena->used = 0;
+}
+
+void vm_arena_reset(vm_arena_t* arena) {
+    arena->used = 0;
+    if (!arena->committed) return;
+#if defined(DISTRO_WIN32)
+    /* Large-page ranges are committed for good; only regular pages decommit */
+    if (arena->committed != arena->reserved || !(arena->flags & VM_ARENA_HUGE_PAGES)) {
+        VirtualFree(arena->base, arena->committed, MEM_DECOMMIT);
+        arena->committed = 0;
+    }
+#else
+    /* Pages stay mapped read/write, the kernel just drops their contents */
+    madvise(arena->base, arena->committed, MADV_DONTNEED);
+#endif
+}
+
+void* vm_arena_malloc_aligned(vm_arena_t* arena, size_t size, size_t alignment) {
+    if (!arena || !arena->base || size == 0) return NULL;
+    if (alignment < MEM_DEFAULT_ALIGNMENT) alignment = MEM_DEFAULT_ALIGNMENT;
+    if (alignment & (alignment - 1)) return NULL;
+
+    /* The reservation is only page-aligned, so align the address, not the offset */
+    uintptr_t base = (uintptr_t)arena->base;
+    size_t start = (size_t)(ALIGN_UP(base + arena->used, alignment) - base);
+    size_t end = start + size;
+    if (start < arena->used || end < size || end > arena->reserved) return NULL;
+
+    if (end > arena->committed) {
+        size_t commit_end = ALIGN_UP(end, arena->granularity);
+        if (commit_end > arena->reserved) commit_end = arena->reserved;
+        if (!_vm_commit(arena->base + arena->committed, commit_end - arena->committed)) return NULL;
+        arena->committed = commit_end;
+    }
+
+    arena->used = end;
+    return arena->base + start;
+}
+
+void* vm_arena_malloc(vm_arena_t* arena, size_t size) {
+    return vm_arena_malloc_aligned(arena, size, MEM_DEFAULT_ALIGNMENT);
+}
+
+size_t vm_arena_mark(vm_arena_t* arena) {
+    return arena->used;
+}
+
+void vm_arena_rewind_to(vm_arena_t* arena, size_t mark) {
+    if (mark < arena->used) arena->used = mark;
+}
+
+/* Virtual memory arena allocator functions */
+void* vm_arena_alloc(void* ctx, size_t size) {
+    return vm_arena_malloc((vm_arena_t*)ctx, size);
+}
+
+void* vm_arena_alloc_aligned(void* ctx, size_t size, size_t alignment) {
+    return vm_arena_malloc_aligned((vm_arena_t*)ctx, size, alignment);
+}
+
+void vm_arena_free_all_fn(void* ctx) {
+    vm_arena_reset((vm_arena_t*)ctx);
+}
+
+void* vm_arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    vm_arena_t* arena = (vm_arena_t*)ctx;
+    if (ptr && (char*)ptr + old_size == arena->base + arena->used) {
+        size_t start = (size_t)((char*)ptr - arena->base);
+        arena->used = start;
+        if (!new_size) return NULL;
+        if (vm_arena_malloc(arena, new_size) == ptr) return ptr;
+        arena->used = start + old_size;
+    }
+    if (!new_size) return NULL;
+
+    void* new_ptr = vm_arena_malloc(arena, new_size);
+    if (ptr && new_ptr && old_size) memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    return new_ptr;
+}
+
+allocator_t vm_arena_allocator(vm_arena_t* arena) {
+    allocator_t a = {
+        .alloc = vm_arena_alloc,
+        .free = arena_free,
+        .free_all = vm_arena_free_all_fn,
+        .realloc = vm_arena_realloc,
+        .ctx = arena,
+        .alloc_aligned = vm_arena_alloc_aligned
+    };
+    return a;
+}
+
+/* ------------------------------ Pool Implementation ----------------------- */
+/* Objects start right after the chunk header, padded so they keep
+ * MEM_DEFAULT_ALIGNMENT. */
+#define _POOL_CHUNK_HEADER ALIGN_UP(sizeof(_pool_chunk), MEM_DEFAULT_ALIGNMENT)
+
+void pool_init(pool_t* pool, size_t object_size, size_t objects_per_chunk) {
+    if (object_size < sizeof(_pool_slot)) object_size = sizeof(_pool_slot);
+    pool->object_size = ALIGN_UP(object_size, MEM_DEFAULT_ALIGNMENT);
+    pool->objects_per_chunk = objects_per_chunk ? objects_per_chunk : 64;
+    pool->root_chunk = NULL;
+    pool->current_chunk = NULL;
+    pool->free_list = NULL;
+    pool->next_object = NULL;
+    pool->chunk_end = NULL;
+}
+
+void pool_destroy(pool_t* pool) {
+    _pool_chunk* chunk = pool->root_chunk;
+    while (chunk) {
+        _pool_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    pool->root_chunk = NULL;
+    pool->current_chunk = NULL;
+    pool->free_list = NULL;
+    pool->next_object = NULL;
+    pool->chunk_end = NULL;
+}
+
+static inline void _pool_use_chunk(pool_t* pool, _pool_chunk* chunk) {
+    pool->current_chunk = chunk;
+    pool->next_object = (char*)chunk + _POOL_CHUNK_HEADER;
+    pool->chunk_end = pool->next_object + pool->object_size * pool->objects_per_chunk;
+}
+
+/* Like the arena, chunks after current_chunk are untouched, so a reset only
+ * rewinds the cursor and drops the free list. */
+void pool_reset(pool_t* pool) {
+    pool->free_list = NULL;
+    if (pool->root_chunk) {
+        _pool_use_chunk(pool, pool->root_chunk);
+    }
+}
+
+static void* _pool_malloc_slow(pool_t* pool) {
+    _pool_chunk* chunk = pool->current_chunk;
+    _pool_chunk* next = chunk ? chunk->next : pool->root_chunk;
+
+    if (!next) {
+        next = malloc(_POOL_CHUNK_HEADER + pool->object_size * pool->objects_per_chunk);
+        if (!next) return NULL;
+        next->next = NULL;
+        if (chunk) chunk->next = next;
+        else pool->root_chunk = next;
+    }
+
+    _pool_use_chunk(pool, next);
+    void* ptr = pool->next_object;
+    pool->next_object += pool->object_size;
+    return ptr;
+}
+
+void* pool_malloc(pool_t* pool) {
+    _pool_slot* slot = pool->free_list;
+    if (slot) {
+        pool->free_list = slot->next;
+        return slot;
+    }
+    if (pool->next_object != pool->chunk_end) {
+        void* ptr = pool->next_object;
+        pool->next_object += pool->object_size;
+        return ptr;
+    }
+    return _pool_malloc_slow(pool);
+}
+
+void pool_release(pool_t* pool, void* ptr) {
+    if (!ptr) return;
+    _pool_slot* slot = (_pool_slot*)ptr;
+    slot->next = pool->free_list;
+    pool->free_list = slot;
+}
+
+/* Pool allocator functions */
+void* pool_alloc(void* ctx, size_t size) {
+    pool_t* pool = (pool_t*)ctx;
+    if (size > pool->object_size) return NULL;
+    return pool_malloc(pool);
+}
+
+void pool_free(void* ctx, void* ptr) {
+    pool_release((pool_t*)ctx, ptr);
+}
+
+void pool_free_all_fn(void* ctx) {
+    pool_reset((pool_t*)ctx);
+}
+
+void* pool_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    pool_t* pool = (pool_t*)ctx;
+    (void)old_size;
+    if (!new_size) {
+        pool_release(pool, ptr);
+        return NULL;
+    }
+    if (new_size > pool->object_size) return NULL;
+    return ptr ? ptr : pool_malloc(pool);
+}
+
+allocator_t pool_allocator(pool_t* pool) {
+    allocator_t a = {
+        .alloc = pool_alloc,
+        .free = pool_free,
+        .free_all = pool_free_all_fn,
+        .realloc = pool_realloc,
+        .ctx = pool,
+        .alloc_aligned = NULL
+    };
+    return a;
+}
+
+/* ------------------------------ Concurrent Pool --------------------------- */
+#define _CPOOL_MIN_CHUNK_SIZE ((size_t)64 * 1024)
+#define _CPOOL_CHUNK_HEADER ALIGN_UP(sizeof(_cpool_chunk), MEM_DEFAULT_ALIGNMENT)
+
+/* Runs when a thread exits: its heap stays in the pool, still reachable by
+ * remote frees, until another thread adopts it. */
+static void _cpool_heap_abandon(void* ctx) {
+    _cpool_heap* heap = (_cpool_heap*)ctx;
+    if (heap) atomic32_store(&heap->owned, 0, MEMORY_ORDER_RELEASE);
+}
+
+bool concurrent_pool_init(concurrent_pool_t* pool, size_t object_size) {
+    if (object_size < sizeof(_pool_slot)) object_size = sizeof(_pool_slot);
+    pool->object_size = ALIGN_UP(object_size, MEM_DEFAULT_ALIGNMENT);
+    atomicptr_init(&pool->heaps, NULL);
+
+    /* At least 64 KiB and 16 objects per chunk, rounded up to a power of two
+     * so chunks can be found by masking */
+    size_t want = _CPOOL_CHUNK_HEADER + pool->object_size * 16;
+    size_t chunk_size = _CPOOL_MIN_CHUNK_SIZE;
+    while (chunk_size < want) chunk_size *= 2;
+    pool->chunk_size = chunk_size;
+
+    return tls_create(&pool->heap_key, _cpool_heap_abandon);
+}
+
+void concurrent_pool_destroy(concurrent_pool_t* pool) {
+    tls_destroy(pool->heap_key);
+    _cpool_heap* heap = atomicptr_load(&pool->heaps, MEMORY_ORDER_ACQUIRE);
+    while (heap) {
+        _cpool_heap* next_heap = heap->next;
+        _cpool_chunk* chunk = heap->chunks;
+        while (chunk) {
+            _cpool_chunk* next = chunk->next;
+            malloc_free(NULL, chunk);
+            chunk = next;
+        }
+        free(heap);
+        heap = next_heap;
+    }
+    atomicptr_store(&pool->heaps, NULL, MEMORY_ORDER_RELAXED);
+}
+
+/* Adopt a heap left behind by an exited thread, or publish a new one. */
+static _cpool_heap* _cpool_attach(concurrent_pool_t* pool) {
+    _cpool_heap* heap = atomicptr_load(&pool->heaps, MEMORY_ORDER_ACQUIRE);
+    for (; heap; heap = heap->next) {
+        int32_t expected = 0;
+        if (atomic32_compare_exchange(&heap->owned, &expected, 1,
+                                      MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_RELAXED)) {
+            tls_set(pool->heap_key, heap);
+            return heap;
+        }
+    }
+
+    heap = calloc(1, sizeof(_cpool_heap));
+    if (!heap) return NULL;
+    atomic32_init(&heap->owned, 1);
+    void* head = atomicptr_load(&pool->heaps, MEMORY_ORDER_RELAXED);
+    do {
+        heap->next = head;
+    } while (!atomicptr_compare_exchange_weak(&pool->heaps, &head, heap,
+                                              MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED));
+    tls_set(pool->heap_key, heap);
+    return heap;
+}
+
+static void* _cpool_malloc_slow(concurrent_pool_t* pool, _cpool_heap* heap) {
+    /* Take everything other threads have handed back in one exchange */
+    _pool_slot* remote = atomicptr_exchange(&heap->remote_free, NULL, MEMORY_ORDER_ACQUIRE);
+    if (remote) {
+        heap->local_free = remote->next;
+        return remote;
+    }
+
+    _cpool_chunk* chunk = malloc_alloc_aligned(NULL, pool->chunk_size, pool->chunk_size);
+    if (!chunk) return NULL;
+    chunk->heap = heap;
+    chunk->next = heap->chunks;
+    heap->chunks = chunk;
+
+    heap->next_object = (char*)chunk + _CPOOL_CHUNK_HEADER;
+    heap->chunk_end = heap->next_object
+        + ((pool->chunk_size - _CPOOL_CHUNK_HEADER) / pool->object_size) * pool->object_size;
+
+    void* ptr = heap->next_object;
+    heap->next_object += pool->object_size;
+    return ptr;
+}
+
+void* concurrent_pool_malloc(concurrent_pool_t* pool) {
+    _cpool_heap* heap = tls_get(pool->heap_key);
+    if (!heap) {
+        heap = _cpool_attach(pool);
+        if (!heap) return NULL;
+    }
+
+    _pool_slot* slot = heap->local_free;
+    if (slot) {
+        heap->local_free = slot->next;
+        return slot;
+    }
+    if (heap->next_object != heap->chunk_end) {
+        void* ptr = heap->next_object;
+        heap->next_object += pool->object_size;
+        return ptr;
+    }
+    return _cpool_malloc_slow(pool, heap);
+}
+
+void concurrent_pool_release(concurrent_pool_t* pool, void* ptr) {
+    if (!ptr) return;
+    _cpool_chunk* chunk = (_cpool_chunk*)((uintptr_t)ptr & ~((uintptr_t)pool->chunk_size - 1));
+    _cpool_heap* owner = chunk->heap;
+    _pool_slot* slot = (_pool_slot*)ptr;
+
+    if (owner == tls_get(pool->heap_key)) {
+        slot->next = owner->local_free;
+        owner->local_free = slot;
+        return;
+    }
+
+    void* head = atomicptr_load(&owner->remote_free, MEMORY_ORDER_RELAXED);
+    do {
+        slot->next = head;
+    } while (!atomicptr_compare_exchange_weak(&owner->remote_free, &head, slot,
+                                              MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED));
+}
+
+/* Concurrent pool allocator functions */
+void* concurrent_pool_alloc(void* ctx, size_t size) {
+    concurrent_pool_t* pool = (concurrent_pool_t*)ctx;
+    if (size > pool->object_size) return NULL;
+    return concurrent_pool_malloc(pool);
+}
+
+void concurrent_pool_free(void* ctx, void* ptr) {
+    concurrent_pool_release((concurrent_pool_t*)ctx, ptr);
+}
+
+void* concurrent_pool_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    concurrent_pool_t* pool = (concurrent_pool_t*)ctx;
+    (void)old_size;
+    if (!new_size) {
+        concurrent_pool_release(pool, ptr);
+        return NULL;
+    }
+    if (new_size > pool->object_size) return NULL;
+    return ptr ? ptr : concurrent_pool_malloc(pool);
+}
+
+allocator_t concurrent_pool_allocator(concurrent_pool_t* pool) {
+    allocator_t a = {
+        .alloc = concurrent_pool_alloc,
+        .free = concurrent_pool_free,
+        .free_all = NULL,
+        .realloc = concurrent_pool_realloc,
+        .ctx = pool,
+        .alloc_aligned = NULL
+    };
+    return a;
+}
+
+/* ------------------------------ Tracking Allocator ------------------------ */
+/* Live bytes a thread may accumulate before folding them into the shared
+ * total. Bounds the peak error to this much per thread. */
+#define _TRACKING_FOLD_THRESHOLD ((int64_t)64 * 1024)
+
+/* Placed in front of every tracked allocation. offset is the distance back
+ * to the start of the backing allocation, which differs from the header size
+ * only for over-aligned allocations. */
+typedef struct {
+    size_t size;
+    uint32_t offset;
+    uint32_t callsite; /* index + 1 into the call-site table, 0 if unknown */
+} _tracking_header;
+
+#define _TRACKING_HEADER_SIZE ALIGN_UP(sizeof(_tracking_header), MEM_DEFAULT_ALIGNMENT)
+
+static THREAD_LOCAL const char* _callsite_file = NULL;
+static THREAD_LOCAL int _callsite_line = 0;
+
+void _alloc_note_callsite(const char* file, int line) {
+    _callsite_file = file;
+    _callsite_line = line;
+}
+
+void* _alloc_clear_callsite(void* ptr) {
+    _callsite_file = NULL;
+    return ptr;
+}
+
+static inline _tracking_header* _tracking_header_of(void* ptr) {
+    return (_tracking_header*)((char*)ptr - sizeof(_tracking_header));
+}
+
+static inline unsigned _tracking_size_class(size_t size) {
+    if (size <= 16) return 0;
+    unsigned bits = (unsigned)(sizeof(unsigned long long) * 8) - (unsigned)__builtin_clzll((unsigned long long)(size - 1));
+    unsigned cls = bits - 4;
+    return cls < TRACKING_SIZE_CLASSES ? cls : TRACKING_SIZE_CLASSES - 1;
+}
+
+/* Owner-only counter update. A relaxed store keeps concurrent readers in
+ * tracking_allocator_stats well defined without a locked instruction. */
+static inline void _tracking_bump(atomic64_t* counter) {
+    atomic64_store(counter, atomic64_load(counter, MEMORY_ORDER_RELAXED) + 1, MEMORY_ORDER_RELAXED);
+}
+
+static void _tracking_fold(tracking_allocator_t* tracker, _tracking_thread_stats* stats) {
+    int64_t delta = atomic64_load(&stats->live_delta, MEMORY_ORDER_RELAXED);
+    atomic64_store(&stats->live_delta, 0, MEMORY_ORDER_RELAXED);
+    int64_t live = atomic64_fetch_add(&tracker->live_bytes, delta, MEMORY_ORDER_RELAXED) + delta;
+    size_t peak = atomicsz_load(&tracker->peak_bytes, MEMORY_ORDER_RELAXED);
+    while (live > 0 && (size_t)live > peak &&
+           !atomicsz_compare_exchange_weak(&tracker->peak_bytes, &peak, (size_t)live,
+                                           MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED)) {
+    }
+}
+
+/* Runs when a thread exits: its pending live bytes go to the shared total
+ * and the node waits, counts intact, for another thread to adopt it. */
+static void _tracking_thread_exit(void* ctx) {
+    _tracking_thread_stats* stats = (_tracking_thread_stats*)ctx;
+    if (!stats) return;
+    _tracking_fold((tracking_allocator_t*)stats->tracker, stats);
+    atomic32_store(&stats->owned, 0, MEMORY_ORDER_RELEASE);
+}
+
+static _tracking_thread_stats* _tracking_thread(tracking_allocator_t* tracker) {
+    _tracking_thread_stats* stats = tls_get(tracker->stats_key);
+    if (stats) return stats;
+
+    /* Adopt a node left behind by an exited thread before making a new one */
+    stats = atomicptr_load(&tracker->threads, MEMORY_ORDER_ACQUIRE);
+    for (; stats; stats = stats->next) {
+        int32_t expected = 0;
+        if (atomic32_load(&stats->owned, MEMORY_ORDER_RELAXED) == 0 &&
+            atomic32_compare_exchange(&stats->owned, &expected, 1, MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_RELAXED)) {
+            tls_set(tracker->stats_key, stats);
+            return stats;
+        }
+    }
+
+    stats = calloc(1, sizeof(_tracking_thread_stats));
+    if (!stats) return NULL;
+    stats->tracker = tracker;
+    atomic32_init(&stats->owned, 1);
+    void* head = atomicptr_load(&tracker->threads, MEMORY_ORDER_RELAXED);
+    do {
+        stats->next = head;
+    } while (!atomicptr_compare_exchange_weak(&tracker->threads, &head, stats,
+                                              MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED));
+    tls_set(tracker->stats_key, stats);
+    return stats;
+}
+
+static inline void _tracking_live(tracking_allocator_t* tracker, _tracking_thread_stats* stats, int64_t delta) {
+    int64_t pending = atomic64_load(&stats->live_delta, MEMORY_ORDER_RELAXED) + delta;
+    atomic64_store(&stats->live_delta, pending, MEMORY_ORDER_RELAXED);
+    if (pending > _TRACKING_FOLD_THRESHOLD || pending < -_TRACKING_FOLD_THRESHOLD) {
+        _tracking_fold(tracker, stats);
+    }
+}
+
+/* New sites stop being added once the table is this full, which keeps
+ * probe sequences short. */
+#define _TRACKING_SITE_LIMIT (TRACKING_MAX_CALLSITES / 4 * 3)
+
+static inline size_t _tracking_site_hash(const char* file, int line) {
+    uint64_t h = ((uint64_t)(uintptr_t)file ^ (uint64_t)(uint32_t)line * 0x9e3779b97f4a7c15ULL) * 0xff51afd7ed558ccdULL;
+    return (size_t)(h >> 32) & (TRACKING_MAX_CALLSITES - 1);
+}
+
+/* Find or claim the slot for file:line without locking. Returns its index,
+ * or TRACKING_MAX_CALLSITES if the table is full. */
+static size_t _tracking_site_find(tracking_allocator_t* tracker, const char* file, int line) {
+    for (size_t i = _tracking_site_hash(file, line), probes = 0; probes < TRACKING_MAX_CALLSITES;
+         i = (i + 1) & (TRACKING_MAX_CALLSITES - 1), probes++) {
+        _tracking_site* site = &tracker->sites[i];
+        int32_t state = atomic32_load(&site->state, MEMORY_ORDER_ACQUIRE);
+        if (state == 0) {
+            if (atomicsz_load(&tracker->site_count, MEMORY_ORDER_RELAXED) >= _TRACKING_SITE_LIMIT) break;
+            if (atomic32_compare_exchange(&site->state, &state, 1, MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_ACQUIRE)) {
+                site->file = file;
+                site->line = line;
+                atomicsz_fetch_add(&tracker->site_count, 1, MEMORY_ORDER_RELAXED);
+                atomic32_store(&site->state, 2, MEMORY_ORDER_RELEASE);
+                return i;
+            }
+        }
+        /* Another thread is publishing this slot; its key is needed to go on */
+        while (state == 1) {
+            cpu_relax();
+            state = atomic32_load(&site->state, MEMORY_ORDER_ACQUIRE);
+        }
+        if (site->file == file && site->line == line) return i;
+    }
+    return TRACKING_MAX_CALLSITES;
+}
+
+/* Consume the call site noted by the allocation macro, if any. */
+static uint32_t _tracking_take_callsite(tracking_allocator_t* tracker, size_t size) {
+    const char* file = _callsite_file;
+    if (!file) return 0;
+    int line = _callsite_line;
+    _callsite_file = NULL;
+
+    size_t i = _tracking_site_find(tracker, file, line);
+    if (i == TRACKING_MAX_CALLSITES) return 0;
+    atomic64_fetch_add(&tracker->sites[i].live_bytes, (int64_t)size, MEMORY_ORDER_RELAXED);
+    atomic64_fetch_add(&tracker->sites[i].alloc_count, 1, MEMORY_ORDER_RELAXED);
+    return (uint32_t)(i + 1);
+}
+
+static void _tracking_release_callsite(tracking_allocator_t* tracker, uint32_t callsite, size_t size) {
+    if (!callsite) return;
+    atomic64_fetch_sub(&tracker->sites[callsite - 1].live_bytes, (int64_t)size, MEMORY_ORDER_RELAXED);
+}
+
+static void* _tracking_record(tracking_allocator_t* tracker, void* base, size_t offset, size_t size) {
+    _tracking_thread_stats* stats = _tracking_thread(tracker);
+    void* ptr = (char*)base + offset;
+    _tracking_header* header = _tracking_header_of(ptr);
+    header->size = size;
+    header->offset = (uint32_t)offset;
+    header->callsite = _tracking_take_callsite(tracker, size);
+
+    if (stats) {
+        _tracking_bump(&stats->alloc_count);
+        _tracking_bump(&stats->size_histogram[_tracking_size_class(size)]);
+        _tracking_live(tracker, stats, (int64_t)size);
+    }
+    return ptr;
+}
+
+bool tracking_allocator_init(tracking_allocator_t* tracker, allocator_t* backing) {
+    tracker->backing = backing ? backing : &default_allocator;
+    atomicptr_init(&tracker->threads, NULL);
+    atomic64_init(&tracker->live_bytes, 0);
+    atomicsz_init(&tracker->peak_bytes, 0);
+    atomicsz_init(&tracker->site_count, 0);
+    tracker->sites = calloc(TRACKING_MAX_CALLSITES, sizeof(_tracking_site));
+    if (!tracker->sites) return false;
+    if (!tls_create(&tracker->stats_key, _tracking_thread_exit)) {
+        free(tracker->sites);
+        tracker->sites = NULL;
+        return false;
+    }
+    return true;
+}
+
+void tracking_allocator_destroy(tracking_allocator_t* tracker) {
+    tls_destroy(tracker->stats_key);
+    _tracking_thread_stats* stats = atomicptr_load(&tracker->threads, MEMORY_ORDER_ACQUIRE);
+    while (stats) {
+        _tracking_thread_stats* next = stats->next;
+        free(stats);
+        stats = next;
+    }
+    atomicptr_store(&tracker->threads, NULL, MEMORY_ORDER_RELAXED);
+    free(tracker->sites);
+    tracker->sites = NULL;
+    atomicsz_store(&tracker->site_count, 0, MEMORY_ORDER_RELAXED);
+}
+
+void tracking_allocator_stats(tracking_allocator_t* tracker, allocator_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+    int64_t live = atomic64_load(&tracker->live_bytes, MEMORY_ORDER_RELAXED);
+
+    _tracking_thread_stats* stats = atomicptr_load(&tracker->threads, MEMORY_ORDER_ACQUIRE);
+    for (; stats; stats = stats->next) {
+        live += atomic64_load(&stats->live_delta, MEMORY_ORDER_RELAXED);
+        out->alloc_count += (uint64_t)atomic64_load(&stats->alloc_count, MEMORY_ORDER_RELAXED);
+        out->free_count += (uint64_t)atomic64_load(&stats->free_count, MEMORY_ORDER_RELAXED);
+        out->realloc_count += (uint64_t)atomic64_load(&stats->realloc_count, MEMORY_ORDER_RELAXED);
+        for (unsigned i = 0; i < TRACKING_SIZE_CLASSES; i++) {
+            out->size_histogram[i] += (uint64_t)atomic64_load(&stats->size_histogram[i], MEMORY_ORDER_RELAXED);
+        }
+    }
+
+    out->live_bytes = live > 0 ? (size_t)live : 0;
+    out->peak_bytes = atomicsz_load(&tracker->peak_bytes, MEMORY_ORDER_RELAXED);
+    if (out->live_bytes > out->peak_bytes) out->peak_bytes = out->live_bytes;
+}
+
+size_t tracking_allocator_callsites(tracking_allocator_t* tracker, tracking_callsite_t* out, size_t max) {
+    size_t count = 0;
+    for (size_t i = 0; i < TRACKING_MAX_CALLSITES; i++) {
+        _tracking_site* site = &tracker->sites[i];
+        if (atomic32_load(&site->state, MEMORY_ORDER_ACQUIRE) != 2) continue;
+        if (out && count < max) {
+            int64_t live = atomic64_load(&site->live_bytes, MEMORY_ORDER_RELAXED);
+            out[count].file = site->file;
+            out[count].line = site->line;
+            out[count].live_bytes = live > 0 ? (size_t)live : 0;
+            out[count].alloc_count = (uint64_t)atomic64_load(&site->alloc_count, MEMORY_ORDER_RELAXED);
+        }
+        count++;
+    }
+    return count;
+}
+
+/* Tracking allocator functions */
+void* tracking_alloc(void* ctx, size_t size) {
+    tracking_allocator_t* tracker = (tracking_allocator_t*)ctx;
+    allocator_t* backing = tracker->backing;
+    void* base = backing->alloc(backing->ctx, _TRACKING_HEADER_SIZE + size);
+    if (!base) return NULL;
+    return _tracking_record(tracker, base, _TRACKING_HEADER_SIZE, size);
+}
+
+void* tracking_alloc_aligned(void* ctx, size_t size, size_t alignment) {
+    tracking_allocator_t* tracker = (tracking_allocator_t*)ctx;
+    if (alignment <= MEM_DEFAULT_ALIGNMENT) return tracking_alloc(ctx, size);
+    size_t offset = ALIGN_UP(_TRACKING_HEADER_SIZE, alignment);
+    void* base = ALLOC_ALIGNED(tracker->backing, offset + size, alignment);
+    if (!base) return NULL;
+    return _tracking_record(tracker, base, offset, size);
+}
+
+void tracking_free(void* ctx, void* ptr) {
+    if (!ptr) return;
+    tracking_allocator_t* tracker = (tracking_allocator_t*)ctx;
+    _tracking_header* header = _tracking_header_of(ptr);
+    _tracking_thread_stats* stats = _tracking_thread(tracker);
+    if (stats) {
+        _tracking_bump(&stats->free_count);
+        _tracking_live(tracker, stats, -(int64_t)header->size);
+    }
+    _tracking_release_callsite(tracker, header->callsite, header->size);
+    tracker->backing->free(tracker->backing->ctx, (char*)ptr - header->offset);
+}
+
+void tracking_free_all(void* ctx) {
+    tracking_allocator_t* tracker = (tracking_allocator_t*)ctx;
+    allocator_t* backing = tracker->backing;
+    if (backing->free_all) backing->free_all(backing->ctx);
+
+    atomic64_store(&tracker->live_bytes, 0, MEMORY_ORDER_RELAXED);
+    _tracking_thread_stats* stats = atomicptr_load(&tracker->threads, MEMORY_ORDER_ACQUIRE);
+    for (; stats; stats = stats->next) {
+        atomic64_store(&stats->live_delta, 0, MEMORY_ORDER_RELAXED);
+    }
+    for (size_t i = 0; i < TRACKING_MAX_CALLSITES; i++) {
+        atomic64_store(&tracker->sites[i].live_bytes, 0, MEMORY_ORDER_RELAXED);
+    }
+}
+
+void* tracking_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    tracking_allocator_t* tracker = (tracking_allocator_t*)ctx;
+    if (!ptr) return tracking_alloc(ctx, new_size);
+    if (!new_size) {
+        tracking_free(ctx, ptr);
+        return NULL;
+    }
+
+    _tracking_header* header = _tracking_header_of(ptr);
+    size_t size = header->size;
+    uint32_t offset = header->offset;
+    uint32_t callsite = header->callsite;
+    (void)old_size;
+
+    /* Over-aligned blocks cannot go through the backing realloc, which would
+     * not keep their alignment */
+    if (offset != _TRACKING_HEADER_SIZE) {
+        void* new_ptr = tracking_alloc(ctx, new_size);
+        if (!new_ptr) return NULL;
+        memcpy(new_ptr, ptr, size < new_size ? size : new_size);
+        tracking_free(ctx, ptr);
+        return new_ptr;
+    }
+
+    allocator_t* backing = tracker->backing;
+    void* base = REALLOC(backing, (char*)ptr - offset, offset + size, offset + new_size);
+    if (!base) return NULL;
+
+    _tracking_thread_stats* stats = _tracking_thread(tracker);
+    if (stats) {
+        _tracking_bump(&stats->realloc_count);
+        _tracking_live(tracker, stats, (int64_t)new_size - (int64_t)size);
+    }
+
+    void* new_ptr = (char*)base + offset;
+    header = _tracking_header_of(new_ptr);
+    header->size = new_size;
+    _tracking_release_callsite(tracker, callsite, size);
+    uint32_t noted = _tracking_take_callsite(tracker, new_size);
+    if (noted) {
+        header->callsite = noted;
+    } else if (callsite) {
+        atomic64_fetch_add(&tracker->sites[callsite - 1].live_bytes, (int64_t)new_size, MEMORY_ORDER_RELAXED);
+    }
+    return new_ptr;
+}
+
+allocator_t tracking_allocator(tracking_allocator_t* tracker) {
+    allocator_t a = {
+        .alloc = tracking_alloc,
+        .free = tracking_free,
+        .free_all = tracker->backing->free_all ? tracking_free_all : NULL,
+        .realloc = tracking_realloc,
+        .ctx = tracker,
+        .alloc_aligned = tracking_alloc_aligned
+    };
+    return a;
+}
+
 /* ------------------------------ Allocator Functions ---------------------- */
+/* _aligned_malloc memory can only be released with _aligned_free, so on Win32
+ * the whole default allocator goes through the _aligned_* family. */
+#if defined(DISTRO_WIN32)
+void* malloc_alloc(void* ctx, size_t size) { (void)ctx; return _aligned_malloc(size, MEM_DEFAULT_ALIGNMENT); }
+void malloc_free(void* ctx, void* ptr) { (void)ctx; _aligned_free(ptr); }
+
+void* malloc_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    (void)ctx; (void)old_size;
+    return _aligned_realloc(ptr, new_size, MEM_DEFAULT_ALIGNMENT);
+}
+
+void* malloc_alloc_aligned(void* ctx, size_t size, size_t alignment) {
+    (void)ctx;
+    if (alignment & (alignment - 1)) return NULL;
+    if (alignment < MEM_DEFAULT_ALIGNMENT) alignment = MEM_DEFAULT_ALIGNMENT;
+    return _aligned_malloc(size, alignment);
+}
+#else
 void* malloc_alloc(void* ctx, size_t size) { (void)ctx; return malloc(size); }
 void malloc_free(void* ctx, void* ptr) { (void)ctx; free(ptr); }
 
@@ -122,6 +1044,16 @@ void* malloc_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
     return realloc(ptr, new_size);
 }
 
+void* malloc_alloc_aligned(void* ctx, size_t size, size_t alignment) {
+    (void)ctx;
+    if (alignment & (alignment - 1)) return NULL;
+    if (alignment <= MEM_DEFAULT_ALIGNMENT) return malloc(size);
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0) return NULL;
+    return ptr;
+}
+#endif
+
 void* _default_realloc(allocator_t* a, void* ptr, size_t old_size, size_t new_size) {
     if (!new_size) {
         if (ptr) FREE(a, ptr);
@@ -134,23 +1066,354 @@ void* _default_realloc(allocator_t* a, void* ptr, size_t old_size, size_t new_si
     return new_ptr;
 }
 
+void* _default_alloc_aligned(allocator_t* a, size_t size, size_t alignment) {
+    if (alignment & (alignment - 1)) return NULL;
+    void* ptr = ALLOC(a, size);
+    if (!ptr || alignment <= MEM_DEFAULT_ALIGNMENT) return ptr;
+    if (((uintptr_t)ptr & (alignment - 1)) == 0) return ptr;
+    FREE(a, ptr);
+    return NULL;
+}
+
+void* _default_realloc_aligned(allocator_t* a, void* ptr, size_t old_size, size_t new_size, size_t alignment) {
+    if (alignment <= MEM_DEFAULT_ALIGNMENT) return REALLOC(a, ptr, old_size, new_size);
+    if (!new_size) {
+        if (ptr) FREE(a, ptr);
+        return NULL;
+    }
+    void* new_ptr = ALLOC_ALIGNED(a, new_size, alignment);
+    if (!new_ptr) return NULL;
+    if (ptr && old_size) memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    if (ptr) FREE(a, ptr);
+    return new_ptr;
+}
+
+void* _alloc_prefer_aligned(allocator_t* a, size_t size, size_t alignment) {
+    if (alignment <= MEM_DEFAULT_ALIGNMENT || !a->alloc_aligned) return ALLOC(a, size);
+    void* ptr = a->alloc_aligned(a->ctx, size, alignment);
+    return ptr ? ptr : ALLOC(a, size);
+}
+
+void* _realloc_prefer_aligned(allocator_t* a, void* ptr, size_t old_size, size_t new_size, size_t alignment) {
+    if (alignment <= MEM_DEFAULT_ALIGNMENT || !a->alloc_aligned) return REALLOC(a, ptr, old_size, new_size);
+    if (!new_size) {
+        if (ptr) FREE(a, ptr);
+        return NULL;
+    }
+    void* new_ptr = _alloc_prefer_aligned(a, new_size, alignment);
+    if (!new_ptr) return NULL;
+    if (ptr && old_size) memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    if (ptr) FREE(a, ptr);
+    return new_ptr;
+}
+
+/* ------------------------------ Size-Class Allocator ---------------------- */
+/* Small objects live in 64 KiB spans carved from one reserved range, so a
+ * pointer belongs to us exactly when it falls inside that range. The span
+ * header records the size class, and everything else goes to malloc. */
+#define _SC_SPAN_SIZE ((size_t)64 * 1024)
+#define _SC_SPAN_HEADER MEM_DEFAULT_ALIGNMENT
+#define _SC_REGION_SIZE (sizeof(void*) == 8 ? (size_t)1 << 36 : (size_t)1 << 28)
+#define _SC_CLASS_COUNT 28
+#define _SC_BATCH 32
+
+/* 16..128 in steps of 16, then four classes per power of two up to 4096 */
+static const uint32_t _sc_class_sizes[_SC_CLASS_COUNT] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096
+};
+
+typedef struct {
+    uint32_t size_class;
+} _sc_span;
+
+typedef struct {
+    mutex_t lock;
+    _pool_slot* list;
+    size_t count;
+} _sc_central;
+
+typedef struct {
+    _pool_slot* list[_SC_CLASS_COUNT];
+    uint32_t count[_SC_CLASS_COUNT];
+    bool registered;
+} _sc_cache;
+
+/* 0 = untouched, 1 = initialising, 2 = ready, 3 = reservation failed */
+static atomic32_t _sc_state;
+static vm_arena_t _sc_region;
+static mutex_t _sc_region_lock;
+static _sc_central _sc_centrals[_SC_CLASS_COUNT];
+static tls_key_t _sc_cache_key;
+static bool _sc_cache_key_ready = false;
+static THREAD_LOCAL _sc_cache _sc_thread_cache;
+
+static inline unsigned _sc_class_of(size_t size) {
+    if (size <= 128) return size ? (unsigned)((size + 15) >> 4) - 1 : 0;
+    /* Four classes per power of two: find the power, then the quarter */
+    unsigned shift = (unsigned)(sizeof(unsigned long long) * 8) - (unsigned)__builtin_clzll((unsigned long long)(size - 1)) - 3;
+    return 8 + (shift - 5) * 4 + (unsigned)(((size - 1) >> shift) & 3);
+}
+
+/* base and reserved never change once the state reads ready, so this needs
+ * no lock; nothing past used has been handed out, so it cannot be freed. */
+static inline bool _sc_owns(void* ptr) {
+    if (atomic32_load(&_sc_state, MEMORY_ORDER_ACQUIRE) != 2) return false;
+    return (char*)ptr >= _sc_region.base && (char*)ptr < _sc_region.base + _sc_region.reserved;
+}
+
+static inline _sc_span* _sc_span_of(void* ptr) {
+    return (_sc_span*)((uintptr_t)ptr & ~((uintptr_t)_SC_SPAN_SIZE - 1));
+}
+
+/* Hand a thread's cached objects back to the central lists. */
+static void _sc_cache_flush(void* ctx) {
+    _sc_cache* cache = (_sc_cache*)ctx;
+    for (unsigned c = 0; c < _SC_CLASS_COUNT; c++) {
+        _pool_slot* head = cache->list[c];
+        if (!head) continue;
+        _pool_slot* tail = head;
+        while (tail->next) tail = tail->next;
+
+        _sc_central* central = &_sc_centrals[c];
+        mutex_lock(&central->lock);
+        tail->next = central->list;
+        central->list = head;
+        central->count += cache->count[c];
+        mutex_unlock(&central->lock);
+
+        cache->list[c] = NULL;
+        cache->count[c] = 0;
+    }
+}
+
+/* The region and TLS key are set up on first use rather than at load, so
+ * programs that never switch to sizeclass_alloc pay nothing for them. */
+static bool _sc_init(void) {
+    int32_t state = atomic32_load(&_sc_state, MEMORY_ORDER_ACQUIRE);
+    while (state < 2) {
+        int32_t expected = 0;
+        if (state == 0 && atomic32_compare_exchange(&_sc_state, &expected, 1,
+                                                    MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_RELAXED)) {
+            for (unsigned c = 0; c < _SC_CLASS_COUNT; c++) {
+                mutex_init(&_sc_centrals[c].lock);
+                _sc_centrals[c].list = NULL;
+                _sc_centrals[c].count = 0;
+            }
+            mutex_init(&_sc_region_lock);
+            _sc_cache_key_ready = tls_create(&_sc_cache_key, _sc_cache_flush);
+            bool ok = vm_arena_init(&_sc_region, _SC_REGION_SIZE, VM_ARENA_DEFAULT);
+            atomic32_store(&_sc_state, ok ? 2 : 3, MEMORY_ORDER_RELEASE);
+            return ok;
+        }
+        thread_yield();
+        state = atomic32_load(&_sc_state, MEMORY_ORDER_ACQUIRE);
+    }
+    return state == 2;
+}
+
+/* Refill a thread's list: take a batch from the central list, or carve a
+ * fresh span when that is empty. */
+static inline void _sc_register(_sc_cache* cache) {
+    if (!cache->registered && _sc_cache_key_ready) {
+        tls_set(_sc_cache_key, cache);
+        cache->registered = true;
+    }
+}
+
+static bool _sc_refill(_sc_cache* cache, unsigned c) {
+    if (!_sc_init()) return false;
+    _sc_register(cache);
+
+    _sc_central* central = &_sc_centrals[c];
+    mutex_lock(&central->lock);
+    if (central->list) {
+        _pool_slot* head = central->list;
+        _pool_slot* tail = head;
+        uint32_t n = 1;
+        while (n < _SC_BATCH && tail->next) {
+            tail = tail->next;
+            n++;
+        }
+        central->list = tail->next;
+        central->count -= n;
+        mutex_unlock(&central->lock);
+
+        tail->next = NULL;
+        cache->list[c] = head;
+        cache->count[c] = n;
+        return true;
+    }
+    mutex_unlock(&central->lock);
+
+    mutex_lock(&_sc_region_lock);
+    _sc_span* span = vm_arena_malloc_aligned(&_sc_region, _SC_SPAN_SIZE, _SC_SPAN_SIZE);
+    mutex_unlock(&_sc_region_lock);
+    if (!span) return false;
+    /* _sc_span_of finds the header by masking, so a misaligned span would
+     * hand every free a bogus size class */
+    if ((uintptr_t)span & (_SC_SPAN_SIZE - 1)) return false;
+    span->size_class = c;
+
+    size_t size = _sc_class_sizes[c];
+    char* first = (char*)span + _SC_SPAN_HEADER;
+    uint32_t n = (uint32_t)((_SC_SPAN_SIZE - _SC_SPAN_HEADER) / size);
+    for (uint32_t i = 0; i + 1 < n; i++) {
+        ((_pool_slot*)(first + i * size))->next = (_pool_slot*)(first + (i + 1) * size);
+    }
+    ((_pool_slot*)(first + (n - 1) * size))->next = NULL;
+    cache->list[c] = (_pool_slot*)first;
+    cache->count[c] = n;
+    return true;
+}
+
+void* sizeclass_alloc(void* ctx, size_t size) {
+    if (size > SIZECLASS_MAX_SIZE) return malloc_alloc(ctx, size);
+
+    unsigned c = _sc_class_of(size);
+    _sc_cache* cache = &_sc_thread_cache;
+    _pool_slot* slot = cache->list[c];
+    if (!slot) {
+        if (!_sc_refill(cache, c)) return malloc_alloc(ctx, size);
+        slot = cache->list[c];
+    }
+    cache->list[c] = slot->next;
+    cache->count[c]--;
+    return slot;
+}
+
+void sizeclass_free(void* ctx, void* ptr) {
+    if (!ptr) return;
+    if (!_sc_owns(ptr)) {
+        malloc_free(ctx, ptr);
+        return;
+    }
+
+    unsigned c = _sc_span_of(ptr)->size_class;
+    _sc_cache* cache = &_sc_thread_cache;
+    _sc_register(cache);
+    _pool_slot* slot = (_pool_slot*)ptr;
+    slot->next = cache->list[c];
+    cache->list[c] = slot;
+
+    /* Keep per-thread lists bounded: give a batch back once one piles up */
+    if (++cache->count[c] >= 2 * _SC_BATCH) {
+        _pool_slot* tail = slot;
+        for (uint32_t i = 1; i < _SC_BATCH; i++) tail = tail->next;
+        cache->list[c] = tail->next;
+        cache->count[c] -= _SC_BATCH;
+
+        _sc_central* central = &_sc_centrals[c];
+        mutex_lock(&central->lock);
+        tail->next = central->list;
+        central->list = slot;
+        central->count += _SC_BATCH;
+        mutex_unlock(&central->lock);
+    }
+}
+
+void* sizeclass_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return sizeclass_alloc(ctx, new_size);
+    if (!new_size) {
+        sizeclass_free(ctx, ptr);
+        return NULL;
+    }
+
+    bool owned = _sc_owns(ptr);
+    if (!owned && new_size > SIZECLASS_MAX_SIZE) return malloc_realloc(ctx, ptr, old_size, new_size);
+    if (owned && new_size <= SIZECLASS_MAX_SIZE && _sc_class_of(new_size) == _sc_span_of(ptr)->size_class) {
+        return ptr;
+    }
+
+    void* new_ptr = sizeclass_alloc(ctx, new_size);
+    if (!new_ptr) return NULL;
+    if (owned && old_size > _sc_class_sizes[_sc_span_of(ptr)->size_class]) {
+        old_size = _sc_class_sizes[_sc_span_of(ptr)->size_class];
+    }
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    sizeclass_free(ctx, ptr);
+    return new_ptr;
+}
+
+void* sizeclass_alloc_aligned(void* ctx, size_t size, size_t alignment) {
+    if (alignment <= MEM_DEFAULT_ALIGNMENT) return sizeclass_alloc(ctx, size);
+    return malloc_alloc_aligned(ctx, size, alignment);
+}
+
+/* ------------------------------ Temp Arena ------------------------------- */
+/* Each thread lazily gets its own temp arena. The THREAD_LOCAL pointer keeps
+ * the lookup cheap; the TLS key only exists so the arena is torn down when
+ * the thread exits. */
+static THREAD_LOCAL arena_t* _tls_temp_arena = NULL;
+static tls_key_t _temp_arena_key;
+static bool _temp_arena_key_ready = false;
+
+/* Runs on the owning thread. Clearing the pointer first means a later TLS
+ * destructor that allocates temp memory gets a fresh arena, not this one. */
+static void _temp_arena_release(void* ctx) {
+    arena_t* arena = (arena_t*)ctx;
+    if (!arena) return;
+    if (_tls_temp_arena == arena) _tls_temp_arena = NULL;
+    arena_destroy(arena);
+    free(arena);
+}
+
+arena_t* temp_arena(void) {
+    arena_t* arena = _tls_temp_arena;
+    if (arena) return arena;
+
+    arena = malloc(sizeof(arena_t));
+    if (!arena) return NULL;
+    arena_init(arena, 1024);
+    if (_temp_arena_key_ready) tls_set(_temp_arena_key, arena);
+    _tls_temp_arena = arena;
+    return arena;
+}
+
+static void* _temp_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    return arena_malloc(temp_arena(), size);
+}
+
+static void* _temp_alloc_aligned(void* ctx, size_t size, size_t alignment) {
+    (void)ctx;
+    return arena_malloc_aligned(temp_arena(), size, alignment);
+}
+
+static void _temp_free_all(void* ctx) {
+    (void)ctx;
+    if (_tls_temp_arena) arena_reset(_tls_temp_arena);
+}
+
+static void* _temp_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    arena_t* arena = temp_arena();
+    if (!arena) return NULL;
+    return arena_realloc(arena, ptr, old_size, new_size);
+}
+
 /* ------------------------------ Global Allocators ------------------------ */
-static arena_t _temp_arena;
 
 allocator_t default_allocator = {
     .alloc = malloc_alloc,
     .free = malloc_free,
     .free_all = NULL,
     .realloc = malloc_realloc,
-    .ctx = NULL
+    .ctx = NULL,
+    .alloc_aligned = malloc_alloc_aligned
 };
 
 allocator_t default_temp_allocator = {
-    .alloc = arena_alloc,
+    .alloc = _temp_alloc,
     .free = arena_free,
-    .free_all = arena_free_all_fn,
-    .realloc = arena_realloc,
-    .ctx = &_temp_arena
+    .free_all = _temp_free_all,
+    .realloc = _temp_realloc,
+    .ctx = NULL,
+    .alloc_aligned = _temp_alloc_aligned
 };
 
 /* ------------------------------ Allocator Control ------------------------ */
@@ -167,13 +1430,24 @@ void set_allocator(allocator_t* target,
     target->free_all = free_all;
     target->realloc = realloc;
     target->ctx = ctx;
+    target->alloc_aligned = NULL;
+}
+
+void set_allocator_aligned(allocator_t* target, alloc_aligned_fn alloc_aligned) {
+    if (!target) return;
+    target->alloc_aligned = alloc_aligned;
 }
 
 /* ------------------------------ Auto init / destroy ---------------------- */
 MEM_CONSTRUCTOR static void _init_temp_allocator(void) {
-    arena_init(&_temp_arena, 1024);
+    _temp_arena_key_ready = tls_create(&_temp_arena_key, _temp_arena_release);
 }
 
+/* Thread-exit destructors do not run for the thread that returns from main,
+ * so its arena is released here. */
 MEM_DESTRUCTOR static void _destroy_temp_allocator(void) {
-    arena_destroy(&_temp_arena);
+    arena_t* arena = _tls_temp_arena;
+    _tls_temp_arena = NULL;
+    if (_temp_arena_key_ready) tls_set(_temp_arena_key, NULL);
+    _temp_arena_release(arena);
 }
@@ -54,12 +54,21 @@ DIESEL_API Patch load_patch(const char *path, const char **symbol_names, size_t
         return p;
     }
 
-    p.symbols = ALLOC(alloc, sizeof(char*) * symbol_count);
+    /* The name copies are packed behind the pointer array in one allocation,
+     * so loading a patch costs two allocations however many symbols it has. */
+    size_t names_size = 0;
+    for (size_t i = 0; i < symbol_count; i++) names_size += strlen(symbol_names[i]) + 1;
+
+    p.symbols = ALLOC(alloc, sizeof(char*) * symbol_count + names_size);
     p.funcs   = ALLOC(alloc, sizeof(void*) * symbol_count);
     p.count   = symbol_count;
 
+    char *names = (char*)(p.symbols + symbol_count);
     for (size_t i = 0; i < symbol_count; i++) {
-        p.symbols[i] = REALLOC_STRDUP(alloc, symbol_names[i]);
+        size_t length = strlen(symbol_names[i]) + 1;
+        memcpy(names, symbol_names[i], length);
+        p.symbols[i] = names;
+        names += length;
         p.funcs[i] = get_symbol(p.handle, symbol_names[i]);
         if (!p.funcs[i]) {
             fprintf(stderr, "Symbol %s not found in %s\n", symbol_names[i], path);
@@ -76,9 +85,6 @@ DIESEL_API void unload_patch(Patch *p, allocator_t *alloc) {
     if (!p || !p->handle) return;
     alloc = alloc ? alloc : &default_allocator;
 
-    for (size_t i = 0; i < p->count; i++) {
-        if (p->symbols[i]) FREE(alloc, p->symbols[i]);
-    }
     FREE(alloc, p->symbols);
     FREE(alloc, p->funcs);
 
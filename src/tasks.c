@@ -0,0 +1,804 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "tasks.h"
+
+/* ------------------------------ Chase-Lev deque ---------------------------- */
+/* Owner pushes and takes at bottom; thieves steal at top. Follows the C11
+ * formulation of Le, Pop, Cohen and Zappa Nardelli ("Correct and Efficient
+ * Work-Stealing for Weak Memory Models", PPoPP 2013), except that push
+ * publishes bottom with a release store rather than a release fence. */
+
+#define _TASK_DEQUE_INITIAL 256
+#define _TASK_SPIN_ROUNDS   64
+
+typedef struct _task_ring {
+    int64_t capacity;
+    struct _task_ring* retired;     /* Older, smaller rings kept until destroy */
+    atomicptr_t slots[];            /* _task_node pointers */
+} _task_ring;
+
+typedef struct {
+    union {
+        atomic64_t top;
+        char _pad_top[CACHE_LINE_SIZE];
+    };
+    union {
+        struct {
+            atomic64_t bottom;
+            atomicptr_t ring;       /* _task_ring */
+        };
+        char _pad_bottom[CACHE_LINE_SIZE];
+    };
+} _task_deque;
+
+struct _thread_pool_worker {
+    _task_deque deque;
+    thread_pool_t* pool;
+    thread_t thread;
+    size_t index;
+    uint64_t rng;
+};
+
+/* Thieves may still be reading a ring after it is replaced, so old rings
+ * are chained off the new one and only freed when the pool is destroyed. */
+static _task_ring* _ring_new(int64_t capacity, _task_ring* retired) {
+    _task_ring* ring = ALLOC(&default_allocator, sizeof(_task_ring) + (size_t)capacity * sizeof(atomicptr_t));
+    if (!ring) return NULL;
+    ring->capacity = capacity;
+    ring->retired = retired;
+    return ring;
+}
+
+static bool _deque_init(_task_deque* dq) {
+    _task_ring* ring = _ring_new(_TASK_DEQUE_INITIAL, NULL);
+    atomic64_init(&dq->top, 0);
+    atomic64_init(&dq->bottom, 0);
+    atomicptr_init(&dq->ring, ring);
+    return ring != NULL;
+}
+
+static void _deque_destroy(_task_deque* dq) {
+    _task_ring* ring = atomicptr_load(&dq->ring, MEMORY_ORDER_RELAXED);
+    while (ring) {
+        _task_ring* retired = ring->retired;
+        FREE(&default_allocator, ring);
+        ring = retired;
+    }
+    atomicptr_store(&dq->ring, NULL, MEMORY_ORDER_RELAXED);
+}
+
+/* Owner only */
+static bool _deque_push(_task_deque* dq, _task_node* node) {
+    int64_t b = atomic64_load(&dq->bottom, MEMORY_ORDER_RELAXED);
+    int64_t t = atomic64_load(&dq->top, MEMORY_ORDER_ACQUIRE);
+    _task_ring* ring = atomicptr_load(&dq->ring, MEMORY_ORDER_RELAXED);
+
+    if (b - t > ring->capacity - 1) {
+        _task_ring* bigger = _ring_new(ring->capacity * 2, ring);
+        if (!bigger) return false;
+        for (int64_t i = t; i < b; i++) {
+            void* node_at = atomicptr_load(&ring->slots[i & (ring->capacity - 1)], MEMORY_ORDER_RELAXED);
+            atomicptr_init(&bigger->slots[i & (bigger->capacity - 1)], node_at);
+        }
+        atomicptr_store(&dq->ring, bigger, MEMORY_ORDER_RELEASE);
+        ring = bigger;
+    }
+    atomicptr_store(&ring->slots[b & (ring->capacity - 1)], node, MEMORY_ORDER_RELAXED);
+    atomic64_store(&dq->bottom, b + 1, MEMORY_ORDER_RELEASE);
+    return true;
+}
+
+/* Owner only */
+static _task_node* _deque_take(_task_deque* dq) {
+    int64_t b = atomic64_load(&dq->bottom, MEMORY_ORDER_RELAXED) - 1;
+    _task_ring* ring = atomicptr_load(&dq->ring, MEMORY_ORDER_RELAXED);
+    atomic64_store(&dq->bottom, b, MEMORY_ORDER_RELAXED);
+    atomic_fence(MEMORY_ORDER_SEQ_CST);
+    int64_t t = atomic64_load(&dq->top, MEMORY_ORDER_RELAXED);
+
+    _task_node* node = NULL;
+    if (t <= b) {
+        node = atomicptr_load(&ring->slots[b & (ring->capacity - 1)], MEMORY_ORDER_RELAXED);
+        if (t == b) {
+            /* Last element: race thieves for it */
+            if (!atomic64_compare_exchange(&dq->top, &t, t + 1, MEMORY_ORDER_SEQ_CST, MEMORY_ORDER_RELAXED)) {
+                node = NULL;
+            }
+            atomic64_store(&dq->bottom, b + 1, MEMORY_ORDER_RELAXED);
+        }
+    } else {
+        atomic64_store(&dq->bottom, b + 1, MEMORY_ORDER_RELAXED);
+    }
+    return node;
+}
+
+/* Any thread. Returns NULL when empty or when another thief won the race. */
+static _task_node* _deque_steal(_task_deque* dq) {
+    int64_t t = atomic64_load(&dq->top, MEMORY_ORDER_ACQUIRE);
+    atomic_fence(MEMORY_ORDER_SEQ_CST);
+    int64_t b = atomic64_load(&dq->bottom, MEMORY_ORDER_ACQUIRE);
+    if (t >= b) return NULL;
+
+    _task_ring* ring = atomicptr_load(&dq->ring, MEMORY_ORDER_ACQUIRE);
+    _task_node* node = atomicptr_load(&ring->slots[t & (ring->capacity - 1)], MEMORY_ORDER_RELAXED);
+    if (!atomic64_compare_exchange(&dq->top, &t, t + 1, MEMORY_ORDER_SEQ_CST, MEMORY_ORDER_RELAXED)) {
+        return NULL;
+    }
+    return node;
+}
+
+static bool _deque_empty(_task_deque* dq) {
+    int64_t t = atomic64_load(&dq->top, MEMORY_ORDER_ACQUIRE);
+    int64_t b = atomic64_load(&dq->bottom, MEMORY_ORDER_ACQUIRE);
+    return t >= b;
+}
+
+/* ------------------------------ Pool internals ----------------------------- */
+
+static THREAD_LOCAL struct _thread_pool_worker* _tls_worker = NULL;
+
+static uint64_t _rng_next(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static _task_node* _inject_pop(thread_pool_t* pool) {
+    if (atomicsz_load(&pool->inject_count, MEMORY_ORDER_ACQUIRE) == 0) return NULL;
+    mutex_lock(&pool->lock);
+    _task_node* node = pool->inject_head;
+    if (node) {
+        pool->inject_head = node->next;
+        if (!pool->inject_head) pool->inject_tail = NULL;
+        atomicsz_fetch_sub(&pool->inject_count, 1, MEMORY_ORDER_RELEASE);
+    }
+    mutex_unlock(&pool->lock);
+    return node;
+}
+
+/* Try every worker once, starting from a random one */
+static _task_node* _steal_any(thread_pool_t* pool, uint64_t* rng, size_t self) {
+    size_t n = pool->worker_count;
+    size_t start = (size_t)(_rng_next(rng) % n);
+    for (size_t i = 0; i < n; i++) {
+        size_t victim = (start + i) % n;
+        if (victim == self) continue;
+        _task_node* node = _deque_steal(&pool->workers[victim].deque);
+        if (node) return node;
+    }
+    return NULL;
+}
+
+static _task_node* _find_task(thread_pool_t* pool, struct _thread_pool_worker* self, uint64_t* rng) {
+    _task_node* node = NULL;
+    if (self) node = _deque_take(&self->deque);
+    if (!node) node = _inject_pop(pool);
+    if (!node) node = _steal_any(pool, rng, self ? self->index : SIZE_MAX);
+    return node;
+}
+
+static bool _has_work(thread_pool_t* pool) {
+    if (atomicsz_load(&pool->inject_count, MEMORY_ORDER_ACQUIRE)) return true;
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        if (!_deque_empty(&pool->workers[i].deque)) return true;
+    }
+    return false;
+}
+
+static void _run_task(thread_pool_t* pool, _task_node* node) {
+    void (*func)(void*) = node->func;
+    void* arg = node->arg;
+    concurrent_pool_release(&pool->task_nodes, node);
+    func(arg);
+
+    if (atomicsz_fetch_sub(&pool->pending, 1, MEMORY_ORDER_SEQ_CST) == 1 &&
+        atomicsz_load(&pool->waiters, MEMORY_ORDER_SEQ_CST) > 0) {
+        mutex_lock(&pool->lock);
+        cond_broadcast(&pool->idle);
+        mutex_unlock(&pool->lock);
+    }
+}
+
+/* Pairs with the sleepers increment in _worker_park: either the submitter
+ * sees the sleeper, or the sleeper sees the new task before waiting. */
+static void _wake_one(thread_pool_t* pool) {
+    atomic_fence(MEMORY_ORDER_SEQ_CST);
+    if (atomicsz_load(&pool->sleepers, MEMORY_ORDER_SEQ_CST) == 0) return;
+    mutex_lock(&pool->lock);
+    cond_signal(&pool->wake);
+    mutex_unlock(&pool->lock);
+}
+
+/* Returns false once the pool is stopping */
+static bool _worker_park(thread_pool_t* pool) {
+    mutex_lock(&pool->lock);
+    atomicsz_fetch_add(&pool->sleepers, 1, MEMORY_ORDER_SEQ_CST);
+    while (!pool->stopping && !_has_work(pool)) {
+        cond_wait(&pool->wake, &pool->lock);
+    }
+    atomicsz_fetch_sub(&pool->sleepers, 1, MEMORY_ORDER_SEQ_CST);
+    bool running = !pool->stopping;
+    mutex_unlock(&pool->lock);
+    return running;
+}
+
+static void _worker_main(void* arg) {
+    struct _thread_pool_worker* self = arg;
+    thread_pool_t* pool = self->pool;
+    _tls_worker = self;
+
+    for (;;) {
+        _task_node* node = NULL;
+        for (int spin = 0; !node && spin < _TASK_SPIN_ROUNDS; spin++) {
+            node = _find_task(pool, self, &self->rng);
+            if (!node && spin >= _TASK_SPIN_ROUNDS / 2) thread_yield();
+        }
+        if (node) {
+            _run_task(pool, node);
+        } else if (!_worker_park(pool)) {
+            break;
+        }
+    }
+    _tls_worker = NULL;
+}
+
+/* ------------------------------ Public API --------------------------------- */
+
+DIESEL_API bool thread_pool_init(thread_pool_t* pool, size_t thread_count) {
+    if (thread_count == 0) thread_count = thread_hardware_concurrency();
+    memset(pool, 0, sizeof(*pool));
+
+    if (!concurrent_pool_init(&pool->task_nodes, sizeof(_task_node))) return false;
+    pool->workers = ALLOC_PREFER_ALIGNED(&default_allocator, thread_count * sizeof(struct _thread_pool_worker), CACHE_LINE_SIZE);
+    if (!pool->workers) {
+        concurrent_pool_destroy(&pool->task_nodes);
+        return false;
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        struct _thread_pool_worker* worker = &pool->workers[i];
+        if (!_deque_init(&worker->deque)) {
+            while (i--) _deque_destroy(&pool->workers[i].deque);
+            FREE(&default_allocator, pool->workers);
+            concurrent_pool_destroy(&pool->task_nodes);
+            return false;
+        }
+        worker->pool = pool;
+        worker->index = i;
+        worker->rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+    }
+    pool->worker_count = thread_count;
+
+    mutex_init(&pool->lock);
+    cond_init(&pool->wake);
+    cond_init(&pool->idle);
+    for (size_t i = 0; i < thread_count; i++) {
+        pool->workers[i].thread = thread_create(_worker_main, &pool->workers[i]);
+    }
+    return true;
+}
+
+DIESEL_API void thread_pool_destroy(thread_pool_t* pool) {
+    thread_pool_wait(pool);
+
+    mutex_lock(&pool->lock);
+    pool->stopping = true;
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->worker_count; i++) thread_join(pool->workers[i].thread);
+    for (size_t i = 0; i < pool->worker_count; i++) _deque_destroy(&pool->workers[i].deque);
+    FREE(&default_allocator, pool->workers);
+    pool->workers = NULL;
+    pool->worker_count = 0;
+
+    cond_destroy(&pool->idle);
+    cond_destroy(&pool->wake);
+    mutex_destroy(&pool->lock);
+    concurrent_pool_destroy(&pool->task_nodes);
+}
+
+DIESEL_API bool thread_pool_submit(thread_pool_t* pool, void (*func)(void*), void* arg) {
+    _task_node* node = concurrent_pool_malloc(&pool->task_nodes);
+    if (!node) return false;
+    node->func = func;
+    node->arg = arg;
+    node->next = NULL;
+    atomicsz_fetch_add(&pool->pending, 1, MEMORY_ORDER_RELAXED);
+
+    struct _thread_pool_worker* self = _tls_worker;
+    if (!self || self->pool != pool || !_deque_push(&self->deque, node)) {
+        mutex_lock(&pool->lock);
+        if (pool->inject_tail) pool->inject_tail->next = node;
+        else pool->inject_head = node;
+        pool->inject_tail = node;
+        atomicsz_fetch_add(&pool->inject_count, 1, MEMORY_ORDER_RELEASE);
+        mutex_unlock(&pool->lock);
+    }
+    _wake_one(pool);
+    return true;
+}
+
+DIESEL_API bool thread_pool_help(thread_pool_t* pool) {
+    struct _thread_pool_worker* self = _tls_worker;
+    if (self && self->pool != pool) self = NULL;
+
+    uint64_t local_rng = (uint64_t)(uintptr_t)&local_rng | 1;
+    _task_node* node = _find_task(pool, self, self ? &self->rng : &local_rng);
+    if (!node) return false;
+    _run_task(pool, node);
+    return true;
+}
+
+DIESEL_API void thread_pool_wait(thread_pool_t* pool) {
+    while (atomicsz_load(&pool->pending, MEMORY_ORDER_ACQUIRE) != 0) {
+        if (thread_pool_help(pool)) continue;
+
+        /* Nothing left to take: the rest is already running on workers */
+        mutex_lock(&pool->lock);
+        atomicsz_fetch_add(&pool->waiters, 1, MEMORY_ORDER_SEQ_CST);
+        while (atomicsz_load(&pool->pending, MEMORY_ORDER_SEQ_CST) != 0 && !_has_work(pool)) {
+            cond_wait(&pool->idle, &pool->lock);
+        }
+        atomicsz_fetch_sub(&pool->waiters, 1, MEMORY_ORDER_SEQ_CST);
+        mutex_unlock(&pool->lock);
+    }
+}
+
+DIESEL_API size_t thread_pool_worker_index(const thread_pool_t* pool) {
+    struct _thread_pool_worker* self = _tls_worker;
+    return self && self->pool == pool ? self->index : SIZE_MAX;
+}
+
+/* ------------------------------ Default pool ------------------------------- */
+
+static thread_pool_t _default_pool;
+static atomic32_t _default_pool_state;   /* 0 = not created, 1 = creating, 2 = ready */
+
+DIESEL_API thread_pool_t* thread_pool_default(void) {
+    int32_t state = atomic32_load(&_default_pool_state, MEMORY_ORDER_ACQUIRE);
+    while (state != 2) {
+        int32_t expected = 0;
+        if (state == 0 && atomic32_compare_exchange(&_default_pool_state, &expected, 1,
+                                                    MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_RELAXED)) {
+            bool ok = thread_pool_init(&_default_pool, 0);
+            atomic32_store(&_default_pool_state, ok ? 2 : 0, MEMORY_ORDER_RELEASE);
+            return ok ? &_default_pool : NULL;
+        }
+        thread_yield();
+        state = atomic32_load(&_default_pool_state, MEMORY_ORDER_ACQUIRE);
+    }
+    return &_default_pool;
+}
+
+/* ------------------------------ Task handles ------------------------------- */
+
+enum { _TASK_FUNC, _TASK_THEN, _TASK_ALL, _TASK_ANY };
+enum { _LINK_THEN, _LINK_ALL, _LINK_ANY, _LINK_WAITER };
+
+typedef struct {
+    atomic32_t woken;
+} _task_waiter;
+
+/* Registration of interest in a task's completion. Links are embedded in
+ * the object that registers them (the continuation, the combinator, or a
+ * waiter's stack frame), so registering never allocates. */
+typedef struct _task_link {
+    int kind;
+    task_t* target;             /* Continuation or combinator to notify */
+    size_t index;               /* Position among a combinator's inputs */
+    _task_waiter* waiter;
+    struct _task_link* next;
+} _task_link;
+
+/* links is set to this once the task has finished; later links see it and
+ * handle the completion themselves */
+#define _TASK_LINKS_CLOSED ((_task_link*)(uintptr_t)1)
+
+struct task_t {
+    int kind;
+    thread_pool_t* pool;
+    union {
+        value_t (*func)(void*);
+        value_t (*then)(value_t, void*);
+    };
+    void* arg;
+    value_t input;              /* _TASK_THEN: the parent's result */
+    value_t result;
+    atomic32_t done;
+    atomicsz_t refs;
+    atomicptr_t links;          /* Lock-free stack of _task_link, then closed */
+    _task_link parent_link;     /* _TASK_THEN: registered on the parent */
+    atomicsz_t remaining;       /* _TASK_ALL: inputs still running */
+    atomic32_t claimed;         /* _TASK_ANY: set by the first input to finish */
+    task_t** inputs;            /* _TASK_ALL/_TASK_ANY, with input_links after */
+    _task_link* input_links;
+    size_t input_count;
+};
+
+static void _task_execute(void* arg);
+
+static task_t* _task_new(int kind, thread_pool_t* pool, size_t refs) {
+    task_t* task = ALLOC(&default_allocator, sizeof(task_t));
+    if (!task) return NULL;
+    memset(task, 0, sizeof(*task));
+    task->kind = kind;
+    task->pool = pool;
+    atomicsz_init(&task->refs, refs);
+    return task;
+}
+
+static bool _task_add_link(task_t* task, _task_link* link) {
+    void* head = atomicptr_load(&task->links, MEMORY_ORDER_ACQUIRE);
+    do {
+        if (head == _TASK_LINKS_CLOSED) return false;
+        link->next = head;
+    } while (!atomicptr_compare_exchange_weak(&task->links, &head, link, MEMORY_ORDER_RELEASE, MEMORY_ORDER_ACQUIRE));
+    return true;
+}
+
+/* Runs inline when there is no pool to submit to or the submit fails */
+static void _task_schedule(task_t* task) {
+    if (!task->pool || !thread_pool_submit(task->pool, _task_execute, task)) _task_execute(task);
+}
+
+static void _task_complete(task_t* task, value_t result);
+
+/* source has finished; tell whoever registered link */
+static void _task_notify(task_t* source, _task_link* link) {
+    task_t* target = link->target;
+    switch (link->kind) {
+    case _LINK_THEN:
+        target->input = source->result;
+        _task_schedule(target);
+        break;
+    case _LINK_ALL:
+        if (atomicsz_fetch_sub(&target->remaining, 1, MEMORY_ORDER_ACQ_REL) == 1) {
+            value_t result = { .kind = VALUE_NONE };
+            for (size_t i = 0; i < target->input_count; i++) {
+                if (target->inputs[i]->result.kind == VALUE_ERROR) {
+                    result = target->inputs[i]->result;
+                    break;
+                }
+            }
+            _task_complete(target, result);
+        }
+        task_release(target);
+        break;
+    case _LINK_ANY:
+        if (atomic32_exchange(&target->claimed, 1, MEMORY_ORDER_ACQ_REL) == 0) {
+            value_t result = { .kind = VALUE_UINT, .u = link->index };
+            _task_complete(target, result);
+        }
+        task_release(target);
+        break;
+    case _LINK_WAITER: {
+        /* The waiter may return as soon as woken is set; waking only uses
+         * the address */
+        _task_waiter* waiter = link->waiter;
+        atomic32_store(&waiter->woken, 1, MEMORY_ORDER_RELEASE);
+        atomic32_wake_one(&waiter->woken);
+        break;
+    }
+    }
+}
+
+static void _task_complete(task_t* task, value_t result) {
+    task->result = result;
+    atomic32_store(&task->done, 1, MEMORY_ORDER_RELEASE);
+
+    _task_link* link = atomicptr_exchange(&task->links, _TASK_LINKS_CLOSED, MEMORY_ORDER_ACQ_REL);
+    while (link) {
+        _task_link* next = link->next;  /* A woken waiter's link dies with its frame */
+        _task_notify(task, link);
+        link = next;
+    }
+}
+
+static void _task_execute(void* arg) {
+    task_t* task = arg;
+    value_t result;
+    if (task->kind == _TASK_THEN) {
+        result = task->input.kind == VALUE_ERROR ? task->input : task->then(task->input, task->arg);
+    } else {
+        result = task->func(task->arg);
+    }
+    _task_complete(task, result);
+    task_release(task);
+}
+
+DIESEL_API task_t* task_submit(thread_pool_t* pool, value_t (*func)(void*), void* arg) {
+    if (!pool && !(pool = thread_pool_default())) return NULL;
+    task_t* task = _task_new(_TASK_FUNC, pool, 2);     /* Caller + execution */
+    if (!task) return NULL;
+    task->func = func;
+    task->arg = arg;
+    if (!thread_pool_submit(pool, _task_execute, task)) {
+        FREE(&default_allocator, task);
+        return NULL;
+    }
+    return task;
+}
+
+DIESEL_API task_t* task_then(task_t* task, value_t (*func)(value_t, void*), void* arg) {
+    task_t* child = _task_new(_TASK_THEN, task->pool, 2);  /* Caller + execution */
+    if (!child) return NULL;
+    child->then = func;
+    child->arg = arg;
+    child->parent_link.kind = _LINK_THEN;
+    child->parent_link.target = child;
+    if (!_task_add_link(task, &child->parent_link)) _task_notify(task, &child->parent_link);
+    return child;
+}
+
+static task_t* _task_combine(int kind, task_t** tasks, size_t count) {
+    /* With no inputs, continuations still need somewhere to run */
+    thread_pool_t* pool = count ? tasks[0]->pool : thread_pool_default();
+    task_t* combined = _task_new(kind, pool, 1 + count);   /* Caller + one per input link */
+    if (!combined) return NULL;
+    if (count == 0) {
+        value_t none = { .kind = VALUE_NONE };
+        _task_complete(combined, none);
+        return combined;
+    }
+
+    combined->inputs = ALLOC(&default_allocator, count * (sizeof(task_t*) + sizeof(_task_link)));
+    if (!combined->inputs) {
+        FREE(&default_allocator, combined);
+        return NULL;
+    }
+    combined->input_links = (_task_link*)(combined->inputs + count);
+    combined->input_count = count;
+    atomicsz_init(&combined->remaining, count);
+    for (size_t i = 0; i < count; i++) combined->inputs[i] = task_retain(tasks[i]);
+
+    /* Registering can complete combined (and drop link references) at any
+     * point, so the caller's reference keeps it alive through this loop. */
+    for (size_t i = 0; i < count; i++) {
+        _task_link* link = &combined->input_links[i];
+        link->kind = kind == _TASK_ALL ? _LINK_ALL : _LINK_ANY;
+        link->target = combined;
+        link->index = i;
+        if (!_task_add_link(tasks[i], link)) _task_notify(tasks[i], link);
+    }
+    return combined;
+}
+
+DIESEL_API task_t* task_when_all(task_t** tasks, size_t count) {
+    return _task_combine(_TASK_ALL, tasks, count);
+}
+
+DIESEL_API task_t* task_when_any(task_t** tasks, size_t count) {
+    return _task_combine(_TASK_ANY, tasks, count);
+}
+
+DIESEL_API bool task_is_done(const task_t* task) {
+    return atomic32_load(&task->done, MEMORY_ORDER_ACQUIRE) != 0;
+}
+
+DIESEL_API value_t task_result(const task_t* task) {
+    if (!task_is_done(task)) {
+        value_t none = { .kind = VALUE_NONE };
+        return none;
+    }
+    return task->result;
+}
+
+DIESEL_API value_t task_wait(task_t* task) {
+    thread_pool_t* pool = task->pool;
+    bool worker = pool && thread_pool_worker_index(pool) != SIZE_MAX;
+
+    for (int spin = 0; !task_is_done(task); spin++) {
+        if (pool && thread_pool_help(pool)) continue;
+        if (worker) {
+            thread_yield();
+        } else if (spin >= _TASK_SPIN_ROUNDS) {
+            _task_waiter waiter;
+            atomic32_init(&waiter.woken, 0);
+            _task_link link = { .kind = _LINK_WAITER, .waiter = &waiter };
+            if (_task_add_link(task, &link)) {
+                while (!atomic32_load(&waiter.woken, MEMORY_ORDER_ACQUIRE)) atomic32_wait(&waiter.woken, 0);
+            }
+        }
+    }
+    return task->result;
+}
+
+DIESEL_API task_t* task_retain(task_t* task) {
+    atomicsz_fetch_add(&task->refs, 1, MEMORY_ORDER_RELAXED);
+    return task;
+}
+
+DIESEL_API void task_release(task_t* task) {
+    if (atomicsz_fetch_sub(&task->refs, 1, MEMORY_ORDER_ACQ_REL) != 1) return;
+    if (task->inputs) {
+        for (size_t i = 0; i < task->input_count; i++) task_release(task->inputs[i]);
+        FREE(&default_allocator, task->inputs);
+    }
+    FREE(&default_allocator, task);
+}
+
+/* ------------------------------ Parallel loops ----------------------------- */
+
+typedef struct {
+    size_t begin;
+    size_t end;
+    atomicsz_t cursor;          /* PARALLEL_DYNAMIC: next unclaimed iteration */
+    size_t grain;               /* Fixed chunk size, or 0 for guided */
+    size_t min_grain;           /* Guided chunks never shrink below this */
+    size_t job_count;
+    atomicsz_t jobs_done;       /* Submitted jobs that have returned */
+    parallel_schedule_t schedule;
+    void (*body)(size_t, size_t, void*);
+    void (*map)(size_t, size_t, void*, void*);
+    void* ctx;
+    char* partials;             /* parallel_reduce: one accumulator per job */
+    size_t partial_stride;
+} _parallel_loop;
+
+typedef struct {
+    _parallel_loop* loop;
+    size_t index;
+} _parallel_job;
+
+static void _parallel_chunk(_parallel_loop* loop, size_t index, size_t b, size_t e) {
+    if (loop->map) loop->map(b, e, loop->partials + index * loop->partial_stride, loop->ctx);
+    else loop->body(b, e, loop->ctx);
+}
+
+/* Start of static range index out of n iterations split job_count ways: the
+ * first n % job_count ranges get one extra. n * index would overflow. */
+static size_t _parallel_static_start(size_t n, size_t job_count, size_t index) {
+    size_t extra = n % job_count;
+    return n / job_count * index + (index < extra ? index : extra);
+}
+
+static void _parallel_run(_parallel_loop* loop, size_t index) {
+    if (loop->schedule == PARALLEL_STATIC) {
+        size_t n = loop->end - loop->begin;
+        size_t b = loop->begin + _parallel_static_start(n, loop->job_count, index);
+        size_t e = loop->begin + _parallel_static_start(n, loop->job_count, index + 1);
+        if (b < e) _parallel_chunk(loop, index, b, e);
+        return;
+    }
+    for (;;) {
+        size_t start = atomicsz_load(&loop->cursor, MEMORY_ORDER_RELAXED);
+        size_t size;
+        do {
+            if (start >= loop->end) return;
+            size_t remaining = loop->end - start;
+            size = loop->grain ? loop->grain : remaining / (2 * loop->job_count);
+            if (size < loop->min_grain) size = loop->min_grain;
+            if (size > remaining) size = remaining;
+        } while (!atomicsz_compare_exchange_weak(&loop->cursor, &start, start + size,
+                                                 MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED));
+        _parallel_chunk(loop, index, start, start + size);
+    }
+}
+
+static void _parallel_job_main(void* arg) {
+    _parallel_job* job = arg;
+    _parallel_loop* loop = job->loop;
+    _parallel_run(loop, job->index);
+    atomicsz_fetch_add(&loop->jobs_done, 1, MEMORY_ORDER_RELEASE);
+}
+
+/* Returns the pool to use, or NULL when the loop should run inline */
+static thread_pool_t* _parallel_setup(_parallel_loop* loop, size_t begin, size_t end, const parallel_options_t* options) {
+    memset(loop, 0, sizeof(*loop));
+    loop->begin = begin;
+    loop->end = end;
+    atomicsz_init(&loop->cursor, begin);
+    if (end <= begin) return NULL;
+
+    size_t inline_below = options && options->inline_below ? options->inline_below : PARALLEL_INLINE_CUTOFF;
+    if (end - begin < inline_below) return NULL;
+
+    thread_pool_t* pool = options && options->pool ? options->pool : thread_pool_default();
+    if (!pool || pool->worker_count < 2) return NULL;
+
+    loop->schedule = options ? options->schedule : PARALLEL_DYNAMIC;
+    loop->grain = options ? options->grain : 0;
+    loop->job_count = pool->worker_count;
+    if (loop->grain && loop->schedule == PARALLEL_DYNAMIC) {
+        size_t chunks = (end - begin + loop->grain - 1) / loop->grain;
+        if (chunks < loop->job_count) loop->job_count = chunks;
+        if (loop->job_count < 2) return NULL;
+    }
+    /* Cap guided chunks at about 64 claims per job */
+    loop->min_grain = (end - begin) / (loop->job_count * 64);
+    if (loop->min_grain == 0) loop->min_grain = 1;
+    return pool;
+}
+
+/* Caller runs job 0 and helps the pool until the submitted jobs return */
+static void _parallel_execute(thread_pool_t* pool, _parallel_loop* loop, _parallel_job* jobs) {
+    size_t submitted = 0;
+    for (size_t i = 1; i < loop->job_count; i++) {
+        jobs[i].loop = loop;
+        jobs[i].index = i;
+        if (thread_pool_submit(pool, _parallel_job_main, &jobs[i])) submitted++;
+        else _parallel_run(loop, i);
+    }
+    _parallel_run(loop, 0);
+    while (atomicsz_load(&loop->jobs_done, MEMORY_ORDER_ACQUIRE) < submitted) {
+        if (!thread_pool_help(pool)) thread_yield();
+    }
+}
+
+/* The caller runs job 0 itself, so the loop body may leave temp allocations
+ * of its own above the scratch. Only rewind when nothing was added after it. */
+static void _parallel_scratch_release(arena_t* scratch, arena_mark_t mark, arena_mark_t top) {
+    arena_mark_t now = arena_mark(scratch);
+    if (now.block == top.block && now.used == top.used) arena_rewind_to(scratch, mark);
+}
+
+DIESEL_API void parallel_for_ex(size_t begin, size_t end, void (*fn)(size_t, size_t, void*), void* ctx,
+                                const parallel_options_t* options) {
+    _parallel_loop loop;
+    thread_pool_t* pool = _parallel_setup(&loop, begin, end, options);
+    if (!pool) {
+        if (begin < end) fn(begin, end, ctx);
+        return;
+    }
+    loop.body = fn;
+    loop.ctx = ctx;
+
+    arena_t* scratch = temp_arena();
+    if (!scratch) {
+        fn(begin, end, ctx);
+        return;
+    }
+    arena_mark_t mark = arena_mark(scratch);
+    _parallel_job* jobs = arena_malloc(scratch, loop.job_count * sizeof(_parallel_job));
+    if (!jobs) {
+        arena_rewind_to(scratch, mark);
+        fn(begin, end, ctx);
+        return;
+    }
+    arena_mark_t top = arena_mark(scratch);
+    _parallel_execute(pool, &loop, jobs);
+    _parallel_scratch_release(scratch, mark, top);
+}
+
+DIESEL_API void parallel_for(size_t begin, size_t end, void (*fn)(size_t, size_t, void*), void* ctx) {
+    parallel_for_ex(begin, end, fn, ctx, NULL);
+}
+
+DIESEL_API void parallel_reduce(size_t begin, size_t end, void* result, size_t result_size,
+                                void (*map)(size_t, size_t, void*, void*),
+                                void (*combine)(void*, const void*, void*),
+                                void* ctx, const parallel_options_t* options) {
+    _parallel_loop loop;
+    thread_pool_t* pool = _parallel_setup(&loop, begin, end, options);
+    if (!pool) {
+        if (begin < end) map(begin, end, result, ctx);
+        return;
+    }
+    loop.map = map;
+    loop.ctx = ctx;
+    /* Accumulators on separate cache lines so participants never share one */
+    loop.partial_stride = ALIGN_UP(result_size, CACHE_LINE_SIZE);
+
+    arena_t* scratch = temp_arena();
+    if (!scratch) {
+        map(begin, end, result, ctx);
+        return;
+    }
+    arena_mark_t mark = arena_mark(scratch);
+    _parallel_job* jobs = arena_malloc(scratch, loop.job_count * sizeof(_parallel_job));
+    loop.partials = arena_malloc_aligned(scratch, loop.job_count * loop.partial_stride, CACHE_LINE_SIZE);
+    if (!jobs || !loop.partials) {
+        arena_rewind_to(scratch, mark);
+        map(begin, end, result, ctx);
+        return;
+    }
+    arena_mark_t top = arena_mark(scratch);
+    for (size_t i = 0; i < loop.job_count; i++) memcpy(loop.partials + i * loop.partial_stride, result, result_size);
+
+    _parallel_execute(pool, &loop, jobs);
+    for (size_t i = 0; i < loop.job_count; i++) combine(result, loop.partials + i * loop.partial_stride, ctx);
+    _parallel_scratch_release(scratch, mark, top);
+}
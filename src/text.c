@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "text.h"
+#include "containers.h"
+
+/* ------------------------------ String builder ---------------------------- */
+
+DIESEL_API void string_builder_init(string_builder_t* sb, allocator_t* alloc) {
+    sb->data = NULL;
+    sb->length = 0;
+    sb->capacity = 0;
+    sb->alloc = alloc ? alloc : &default_allocator;
+}
+
+DIESEL_API void string_builder_free(string_builder_t* sb) {
+    if (sb->data) FREE(sb->alloc, sb->data);
+    sb->data = NULL;
+    sb->length = 0;
+    sb->capacity = 0;
+}
+
+DIESEL_API bool string_builder_reserve(string_builder_t* sb, size_t extra) {
+    size_t needed = sb->length + extra + 1;
+    if (needed <= sb->capacity) return true;
+
+    size_t capacity = sb->capacity ? sb->capacity * 2 : 64;
+    if (capacity < needed) capacity = needed;
+    char* data = REALLOC(sb->alloc, sb->data, sb->capacity, capacity);
+    if (!data) return false;
+    if (!sb->data) data[0] = '\0';
+    sb->data = data;
+    sb->capacity = capacity;
+    return true;
+}
+
+DIESEL_API bool string_builder_append_n(string_builder_t* sb, const char* str, size_t length) {
+    if (!string_builder_reserve(sb, length)) return false;
+    memcpy(sb->data + sb->length, str, length);
+    sb->length += length;
+    sb->data[sb->length] = '\0';
+    return true;
+}
+
+DIESEL_API bool string_builder_append(string_builder_t* sb, string_t str) {
+    return string_builder_append_n(sb, str, strlen(str));
+}
+
+DIESEL_API bool string_builder_append_char(string_builder_t* sb, char c) {
+    if (!string_builder_reserve(sb, 1)) return false;
+    sb->data[sb->length++] = c;
+    sb->data[sb->length] = '\0';
+    return true;
+}
+
+DIESEL_API bool string_builder_appendvf(string_builder_t* sb, const char* fmt, va_list args) {
+    va_list retry;
+    va_copy(retry, args);
+
+    size_t room = sb->capacity ? sb->capacity - sb->length : 0;
+    int written = vsnprintf(room ? sb->data + sb->length : NULL, room, fmt, args);
+    if (written < 0) {
+        va_end(retry);
+        if (room) sb->data[sb->length] = '\0';
+        return false;
+    }
+    if ((size_t)written >= room) {
+        if (!string_builder_reserve(sb, (size_t)written)) {
+            va_end(retry);
+            if (room) sb->data[sb->length] = '\0';
+            return false;
+        }
+        vsnprintf(sb->data + sb->length, (size_t)written + 1, fmt, retry);
+    }
+    va_end(retry);
+    sb->length += (size_t)written;
+    return true;
+}
+
+DIESEL_API bool string_builder_appendf(string_builder_t* sb, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    bool ok = string_builder_appendvf(sb, fmt, args);
+    va_end(args);
+    return ok;
+}
+
+DIESEL_API void string_builder_clear(string_builder_t* sb) {
+    sb->length = 0;
+    if (sb->data) sb->data[0] = '\0';
+}
+
+DIESEL_API string_t string_builder_cstr(const string_builder_t* sb) {
+    return sb->data ? sb->data : "";
+}
+
+/* ------------------------------ String interner --------------------------- */
+
+#define _INTERNER_ARENA_BLOCK 4096
+
+static uint64_t _intern_hash(const char* str, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)str[i];
+        h *= 0x100000001b3ULL;
+    }
+    return hash_u64(h ^ length);
+}
+
+/* Index of the slot holding str, or of the empty slot where it belongs */
+static size_t _intern_probe(const _interner_slot* slots, size_t capacity, uint64_t hash, const char* str, size_t length) {
+    size_t mask = capacity - 1;
+    size_t i = (size_t)hash & mask;
+    while (slots[i].str) {
+        if (slots[i].hash == hash && slots[i].length == length && memcmp(slots[i].str, str, length) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static bool _intern_grow(string_interner_t* interner) {
+    size_t capacity = interner->capacity ? interner->capacity * 2 : 64;
+    _interner_slot* slots = ALLOC(interner->alloc, capacity * sizeof(_interner_slot));
+    if (!slots) return false;
+    memset(slots, 0, capacity * sizeof(_interner_slot));
+
+    for (size_t i = 0; i < interner->capacity; i++) {
+        _interner_slot* slot = &interner->slots[i];
+        if (!slot->str) continue;
+        size_t j = (size_t)slot->hash & (capacity - 1);
+        while (slots[j].str) j = (j + 1) & (capacity - 1);
+        slots[j] = *slot;
+    }
+    if (interner->slots) FREE(interner->alloc, interner->slots);
+    interner->slots = slots;
+    interner->capacity = capacity;
+    return true;
+}
+
+DIESEL_API void string_interner_init(string_interner_t* interner, allocator_t* alloc) {
+    arena_init(&interner->storage, _INTERNER_ARENA_BLOCK);
+    interner->slots = NULL;
+    interner->count = 0;
+    interner->capacity = 0;
+    interner->alloc = alloc ? alloc : &default_allocator;
+}
+
+DIESEL_API void string_interner_destroy(string_interner_t* interner) {
+    arena_destroy(&interner->storage);
+    if (interner->slots) FREE(interner->alloc, interner->slots);
+    interner->slots = NULL;
+    interner->count = 0;
+    interner->capacity = 0;
+}
+
+DIESEL_API string_t string_interner_find(const string_interner_t* interner, const char* str, size_t length) {
+    if (!interner->capacity) return NULL;
+    uint64_t hash = _intern_hash(str, length);
+    return interner->slots[_intern_probe(interner->slots, interner->capacity, hash, str, length)].str;
+}
+
+DIESEL_API string_t string_intern_n(string_interner_t* interner, const char* str, size_t length) {
+    /* Keep the load factor under 3/4 */
+    if ((interner->count + 1) * 4 > interner->capacity * 3 && !_intern_grow(interner)) return NULL;
+
+    uint64_t hash = _intern_hash(str, length);
+    _interner_slot* slot = &interner->slots[_intern_probe(interner->slots, interner->capacity, hash, str, length)];
+    if (slot->str) return slot->str;
+
+    char* copy = arena_malloc(&interner->storage, length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+
+    slot->hash = hash;
+    slot->str = copy;
+    slot->length = length;
+    interner->count++;
+    return copy;
+}
+
+DIESEL_API string_t string_intern(string_interner_t* interner, string_t str) {
+    return string_intern_n(interner, str, strlen(str));
+}
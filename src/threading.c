@@ -41,10 +41,76 @@ DIESEL_API void mutex_destroy(mutex_t* mutex) {
     DeleteCriticalSection(mutex);
 }
 
+DIESEL_API void cond_init(cond_t* cond) {
+    InitializeConditionVariable(cond);
+}
+
+DIESEL_API void cond_wait(cond_t* cond, mutex_t* mutex) {
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+DIESEL_API void cond_signal(cond_t* cond) {
+    WakeConditionVariable(cond);
+}
+
+DIESEL_API void cond_broadcast(cond_t* cond) {
+    WakeAllConditionVariable(cond);
+}
+
+DIESEL_API void cond_destroy(cond_t* cond) {
+    (void)cond; // Windows condition variables hold no resources
+}
+
+DIESEL_API size_t thread_hardware_concurrency(void) {
+    DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    return count ? (size_t)count : 1;
+}
+
+// Fiber-local storage is used instead of TlsAlloc because only FLS runs a
+// callback when the thread exits.
+DIESEL_API bool tls_create(tls_key_t* key, void (*destructor)(void*)) {
+    *key = FlsAlloc((PFLS_CALLBACK_FUNCTION)destructor);
+    return *key != FLS_OUT_OF_INDEXES;
+}
+
+DIESEL_API void* tls_get(tls_key_t key) {
+    return FlsGetValue(key);
+}
+
+DIESEL_API void tls_set(tls_key_t key, void* value) {
+    FlsSetValue(key, value);
+}
+
+DIESEL_API void tls_destroy(tls_key_t key) {
+    FlsFree(key);
+}
+
+#if defined(_MSC_VER)
+    #pragma comment(lib, "Synchronization.lib")
+#endif
+
+DIESEL_API void atomic32_wait(atomic32_t* a, int32_t expected) {
+    WaitOnAddress((volatile VOID*)&a->value, &expected, sizeof(expected), INFINITE);
+}
+
+DIESEL_API void atomic32_wake_one(atomic32_t* a) {
+    WakeByAddressSingle((PVOID)&a->value);
+}
+
+DIESEL_API void atomic32_wake_all(atomic32_t* a) {
+    WakeByAddressAll((PVOID)&a->value);
+}
+
 #else
 
 // -------------------- POSIX Implementation --------------------
 
+#include <unistd.h>
+#if defined(__linux__)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#endif
+
 DIESEL_API thread_t thread_create(void (*func)(void*), void* arg) {
     pthread_t thread;
     pthread_create(&thread, NULL, (void* (*)(void*))func, arg);
@@ -75,4 +141,146 @@ DIESEL_API void mutex_destroy(mutex_t* mutex) {
     pthread_mutex_destroy(mutex);
 }
 
+DIESEL_API void cond_init(cond_t* cond) {
+    pthread_cond_init(cond, NULL);
+}
+
+DIESEL_API void cond_wait(cond_t* cond, mutex_t* mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+DIESEL_API void cond_signal(cond_t* cond) {
+    pthread_cond_signal(cond);
+}
+
+DIESEL_API void cond_broadcast(cond_t* cond) {
+    pthread_cond_broadcast(cond);
+}
+
+DIESEL_API void cond_destroy(cond_t* cond) {
+    pthread_cond_destroy(cond);
+}
+
+DIESEL_API size_t thread_hardware_concurrency(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+DIESEL_API bool tls_create(tls_key_t* key, void (*destructor)(void*)) {
+    return pthread_key_create(key, destructor) == 0;
+}
+
+DIESEL_API void* tls_get(tls_key_t key) {
+    return pthread_getspecific(key);
+}
+
+DIESEL_API void tls_set(tls_key_t key, void* value) {
+    pthread_setspecific(key, value);
+}
+
+DIESEL_API void tls_destroy(tls_key_t key) {
+    pthread_key_delete(key);
+}
+
+#if defined(__linux__)
+
+DIESEL_API void atomic32_wait(atomic32_t* a, int32_t expected) {
+    syscall(SYS_futex, (void*)&a->value, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+DIESEL_API void atomic32_wake_one(atomic32_t* a) {
+    syscall(SYS_futex, (void*)&a->value, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+DIESEL_API void atomic32_wake_all(atomic32_t* a) {
+    syscall(SYS_futex, (void*)&a->value, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+}
+
+#else
+
+// Without a futex, waiters sleep on one of a fixed set of condition
+// variables picked by address. Unrelated words can share a bucket, so a
+// wake broadcasts and the waiters recheck their own word.
+#define _PARK_BUCKETS 64
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} _park_buckets[_PARK_BUCKETS];
+static pthread_once_t _park_once = PTHREAD_ONCE_INIT;
+
+static void _park_init(void) {
+    for (int i = 0; i < _PARK_BUCKETS; i++) {
+        pthread_mutex_init(&_park_buckets[i].lock, NULL);
+        pthread_cond_init(&_park_buckets[i].cond, NULL);
+    }
+}
+
+static size_t _park_bucket(const atomic32_t* a) {
+    return ((uintptr_t)a >> 4) % _PARK_BUCKETS;
+}
+
+DIESEL_API void atomic32_wait(atomic32_t* a, int32_t expected) {
+    pthread_once(&_park_once, _park_init);
+    size_t b = _park_bucket(a);
+    pthread_mutex_lock(&_park_buckets[b].lock);
+    if (atomic32_load(a, MEMORY_ORDER_SEQ_CST) == expected) {
+        pthread_cond_wait(&_park_buckets[b].cond, &_park_buckets[b].lock);
+    }
+    pthread_mutex_unlock(&_park_buckets[b].lock);
+}
+
+DIESEL_API void atomic32_wake_one(atomic32_t* a) {
+    atomic32_wake_all(a);
+}
+
+DIESEL_API void atomic32_wake_all(atomic32_t* a) {
+    pthread_once(&_park_once, _park_init);
+    size_t b = _park_bucket(a);
+    pthread_mutex_lock(&_park_buckets[b].lock);
+    pthread_cond_broadcast(&_park_buckets[b].cond);
+    pthread_mutex_unlock(&_park_buckets[b].lock);
+}
+
+#endif // __linux__
+
 #endif
+
+// -------------------- Locks --------------------
+
+// Polls of an unlocked-looking adaptive mutex before parking. With backoff
+// doubling up to SPIN_BACKOFF_LIMIT this covers a few microseconds.
+#define _ADAPTIVE_SPIN_ROUNDS 16
+
+DIESEL_API void adaptive_mutex_lock_slow(adaptive_mutex_t* mutex) {
+    int backoff = 1;
+    for (int round = 0; round < _ADAPTIVE_SPIN_ROUNDS; round++) {
+        int32_t state = atomic32_load(&mutex->state, MEMORY_ORDER_RELAXED);
+        if (state == 0 && adaptive_mutex_try_lock(mutex)) return;
+        if (state == 2) break;  // Others are already parked; don't jump the queue
+        for (int i = 0; i < backoff; i++) cpu_relax();
+        if (backoff < SPIN_BACKOFF_LIMIT) backoff *= 2;
+    }
+
+    // Taking the lock as 2 is conservative: the unlock may wake a thread
+    // that finds nothing to do, but no sleeper is ever missed.
+    while (atomic32_exchange(&mutex->state, 2, MEMORY_ORDER_ACQUIRE) != 0) {
+        atomic32_wait(&mutex->state, 2);
+    }
+}
+
+// Waiters further back in line poll less often, so the lock word is not
+// hammered by threads that cannot get it anyway. Long lines, and waits that
+// outlast the spin budget, yield so a preempted holder can run.
+DIESEL_API void ticket_lock_wait(ticket_lock_t* lock, int32_t ticket) {
+    for (int polls = 0;; polls++) {
+        int32_t serving = atomic32_load(&lock->serving, MEMORY_ORDER_ACQUIRE);
+        if (serving == ticket) return;
+        uint32_t ahead = (uint32_t)ticket - (uint32_t)serving;
+        if (ahead > SPIN_BACKOFF_LIMIT / 8 || polls >= _ADAPTIVE_SPIN_ROUNDS) {
+            thread_yield();
+        } else {
+            for (uint32_t i = 0; i < ahead * 8; i++) cpu_relax();
+        }
+    }
+}
@@ -0,0 +1,46 @@
+/* Regression check: BTREE bulk_load on a tree that allocates from the
+ * thread's temp arena. Its scratch arrays used to be released by rewinding
+ * that same arena, which also released the nodes just built, so later temp
+ * allocations overwrote the tree. */
+#include "containers.h"
+#include <stdio.h>
+
+static int int_cmp(int a, int b) {
+    return (a > b) - (a < b);
+}
+
+BTREE_DEFINE(int, int, ibt, int_cmp)
+
+#define COUNT 5000
+
+int main(void) {
+    static int keys[COUNT], values[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        keys[i] = i * 2;
+        values[i] = i;
+    }
+
+    ibt tree;
+    ibt_init(&tree, &default_temp_allocator);
+    if (!ibt_bulk_load(&tree, keys, values, COUNT)) {
+        fprintf(stderr, "bulk_load failed\n");
+        return 1;
+    }
+
+    /* Reuse whatever the arena considers free */
+    for (int i = 0; i < 4096; i++) {
+        char* p = ALLOC(&default_temp_allocator, 64);
+        if (p) memset(p, 0xff, 64);
+    }
+
+    for (int i = 0; i < COUNT; i++) {
+        int* value = ibt_get(&tree, keys[i]);
+        if (!value || *value != values[i]) {
+            fprintf(stderr, "key %d lost after temp allocations\n", keys[i]);
+            return 1;
+        }
+    }
+    FREE_ALL(&default_temp_allocator);
+    printf("btree_bulk_load: ok\n");
+    return 0;
+}